@@ -4,44 +4,65 @@
 
 # Add inputs and outputs from these tool invocations to the build variables 
 C_SRCS += \
+../audit_log.c \
 ../buzzer.c \
+../credential_store.c \
 ../dc_motor.c \
 ../delay.c \
 ../door_locking_control.c \
 ../external_eeprom.c \
 ../gpio.c \
+../link.c \
+../power.c \
+../scheduler.c \
+../sw_timer.c \
 ../timer.c \
 ../twi.c \
-../uart.c 
+../uart.c \
+../user_store.c 
 
 OBJS += \
+./audit_log.o \
 ./buzzer.o \
+./credential_store.o \
 ./dc_motor.o \
 ./delay.o \
 ./door_locking_control.o \
 ./external_eeprom.o \
 ./gpio.o \
+./link.o \
+./power.o \
+./scheduler.o \
+./sw_timer.o \
 ./timer.o \
 ./twi.o \
-./uart.o 
+./uart.o \
+./user_store.o 
 
 C_DEPS += \
+./audit_log.d \
 ./buzzer.d \
+./credential_store.d \
 ./dc_motor.d \
 ./delay.d \
 ./door_locking_control.d \
 ./external_eeprom.d \
 ./gpio.d \
+./link.d \
+./power.d \
+./scheduler.d \
+./sw_timer.d \
 ./timer.d \
 ./twi.d \
-./uart.d 
+./uart.d \
+./user_store.d 
 
 
 # Each subdirectory must supply rules for building sources it contributes
 %.o: ../%.c subdir.mk
 	@echo 'Building file: $<'
 	@echo 'Invoking: AVR Compiler'
-	avr-gcc -Wall -g2 -gstabs -O0 -fpack-struct -fshort-enums -ffunction-sections -fdata-sections -std=gnu99 -funsigned-char -funsigned-bitfields -mmcu=atmega16 -DF_CPU=1000000UL -MMD -MP -MF"$(@:%.o=%.d)" -MT"$@" -c -o "$@" "$<"
+	avr-gcc -Wall -g2 -gstabs -O0 -fpack-struct -fshort-enums -ffunction-sections -fdata-sections -std=gnu99 -funsigned-char -funsigned-bitfields -mmcu=atmega16 -DF_CPU=8000000UL -MMD -MP -MF"$(@:%.o=%.d)" -MT"$@" -c -o "$@" "$<"
 	@echo 'Finished building: $<'
 	@echo ' '
 
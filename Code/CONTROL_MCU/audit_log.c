@@ -0,0 +1,271 @@
+ /******************************************************************************
+ *
+ * Module: AUDIT LOG
+ *
+ * File Name: audit_log.c
+ *
+ * Description: Source file for the access log of the door, a circular log in the external
+ *              EEPROM filled from a RAM buffer by page writes.
+ *
+ * Author: Mohamed Khaled.
+ *
+ *******************************************************************************/
+
+#include "audit_log.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/* Entry: [sequence MSB, sequence LSB, event, user, time 23..16, 15..8, 7..0, CRC-8 of the previous bytes]. */
+#define AUDIT_ENTRY_EVENT                 2
+#define AUDIT_ENTRY_USER                  3
+#define AUDIT_ENTRY_TIME                  4
+#define AUDIT_ENTRY_CRC                   (AUDIT_ENTRY_SIZE - 1)
+#define AUDIT_TIME_MASK                   0x00FFFFFFUL
+
+#define AUDIT_ENTRIES_PER_PAGE            (EEPROM_PAGE_SIZE / AUDIT_ENTRY_SIZE)
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+
+/* Sequence of the next recorded entry and of the next entry written to EEPROM, the first buffered one. */
+static uint16 g_nextSequence = 0;
+static uint16 g_storedSequence = 0;
+/* Index of the next entry written to EEPROM in the area and the number of entries kept there. */
+static uint8 g_head = 0;
+static uint8 g_storedCount = 0;
+
+/* Entries not written yet, the first g_flushCount ones are under writing. */
+static uint8 g_buffer[AUDIT_BUFFER_ENTRIES * AUDIT_ENTRY_SIZE];
+static uint8 g_bufferCount = 0;
+static uint8 g_flushCount = 0;
+/* Time of the first buffered entry. */
+static uint32 g_bufferTime = 0;
+/* Entries dropped while the buffer is full, not recorded yet. */
+static uint8 g_droppedCount = 0;
+
+/*******************************************************************************
+ *                      Private Functions Prototypes                           *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Returns the CRC-8 (polynomial 0x07) of the entry bytes before the CRC byte.
+ */
+static uint8 AUDIT_calculateCrc(const uint8 *entry);
+
+/*
+ * Description :
+ * Adds the entry to the buffer or counts it as dropped if the buffer is full.
+ */
+static void AUDIT_append(uint8 event, uint8 user, uint32 time);
+
+/*
+ * Description :
+ * Returns the time saved in the entry.
+ */
+static uint32 AUDIT_getEntryTime(const uint8 *entry);
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+uint8 AUDIT_init(void)
+{
+	uint8 page[EEPROM_PAGE_SIZE];
+	const uint8 *entry;
+	uint16 sequence;
+	uint16 newestSequence = 0;
+	uint8 newestIndex = 0;
+	boolean found = FALSE;
+
+	g_storedCount = 0;
+	g_bufferCount = 0;
+	g_flushCount = 0;
+	g_droppedCount = 0;
+	for(uint8 index = 0; index < AUDIT_ENTRY_COUNT; index++)
+	{
+		if(((index % AUDIT_ENTRIES_PER_PAGE) == 0) && (EEPROM_readBlock(AUDIT_LOG_ADDRESS +
+				(uint16)index * AUDIT_ENTRY_SIZE, page, EEPROM_PAGE_SIZE) == ERROR))
+		{
+			return ERROR;
+		}
+		entry = &page[(index % AUDIT_ENTRIES_PER_PAGE) * AUDIT_ENTRY_SIZE];
+		/* An erased entry or an entry torn by a power failure is skipped. */
+		if(entry[AUDIT_ENTRY_CRC] != AUDIT_calculateCrc(entry))
+		{
+			continue;
+		}
+		g_storedCount++;
+		sequence = ((uint16)entry[0] << 8) | entry[1];
+		/* The entries are written in turn, so the comparison survives the wrap around of the sequence. */
+		if(!found || ((sint16)(sequence - newestSequence) > 0))
+		{
+			found = TRUE;
+			newestSequence = sequence;
+			newestIndex = index;
+		}
+	}
+
+	if(found)
+	{
+		g_storedSequence = newestSequence + 1;
+		g_head = (newestIndex + 1) % AUDIT_ENTRY_COUNT;
+	}
+	g_nextSequence = g_storedSequence;
+	return SUCCESS;
+}
+
+void AUDIT_record(uint8 event, uint8 user, uint32 time)
+{
+	/* The overflow entry takes the place of the oldest dropped entry, so the order is kept. */
+	if((g_droppedCount != 0) && (g_bufferCount < AUDIT_BUFFER_ENTRIES))
+	{
+		AUDIT_append(AUDIT_EVENT_OVERFLOW, g_droppedCount, time);
+		g_droppedCount = 0;
+	}
+	AUDIT_append(event, user, time);
+}
+
+static void AUDIT_append(uint8 event, uint8 user, uint32 time)
+{
+	uint8 *entry;
+
+	if(g_bufferCount == AUDIT_BUFFER_ENTRIES)
+	{
+		if(g_droppedCount != 0xFF)
+		{
+			g_droppedCount++;
+		}
+		return;
+	}
+	entry = &g_buffer[g_bufferCount * AUDIT_ENTRY_SIZE];
+	entry[0] = (uint8)(g_nextSequence >> 8);
+	entry[1] = (uint8)g_nextSequence;
+	entry[AUDIT_ENTRY_EVENT] = event;
+	entry[AUDIT_ENTRY_USER] = user;
+	entry[AUDIT_ENTRY_TIME] = (uint8)(time >> 16);
+	entry[AUDIT_ENTRY_TIME + 1] = (uint8)(time >> 8);
+	entry[AUDIT_ENTRY_TIME + 2] = (uint8)time;
+	entry[AUDIT_ENTRY_CRC] = AUDIT_calculateCrc(entry);
+	if(g_bufferCount == 0)
+	{
+		g_bufferTime = time;
+	}
+	g_bufferCount++;
+	g_nextSequence++;
+}
+
+boolean AUDIT_startFlush(TWI_Transaction *transaction, uint32 time)
+{
+	uint8 pageFree = AUDIT_ENTRIES_PER_PAGE - (g_head % AUDIT_ENTRIES_PER_PAGE);
+
+	if((g_bufferCount == 0) || (g_flushCount != 0))
+	{
+		return FALSE;
+	}
+	/* The page is written once when it is filled, a partly filled page is written after the delay. */
+	if((g_bufferCount < pageFree) && (((time - g_bufferTime) & AUDIT_TIME_MASK) < AUDIT_FLUSH_DELAY_S))
+	{
+		return FALSE;
+	}
+	g_flushCount = (g_bufferCount < pageFree) ? g_bufferCount : pageFree;
+	EEPROM_startWrite(transaction, AUDIT_LOG_ADDRESS + (uint16)g_head * AUDIT_ENTRY_SIZE, g_buffer,
+			g_flushCount * AUDIT_ENTRY_SIZE);
+	return TRUE;
+}
+
+void AUDIT_endFlush(boolean written)
+{
+	if(written)
+	{
+		g_storedSequence += g_flushCount;
+		g_head = (g_head + g_flushCount) % AUDIT_ENTRY_COUNT;
+		g_storedCount = (g_storedCount + g_flushCount < AUDIT_ENTRY_COUNT) ?
+				(g_storedCount + g_flushCount) : AUDIT_ENTRY_COUNT;
+		g_bufferCount -= g_flushCount;
+		for(uint8 i = 0; i < g_bufferCount * AUDIT_ENTRY_SIZE; i++)
+		{
+			g_buffer[i] = g_buffer[i + g_flushCount * AUDIT_ENTRY_SIZE];
+		}
+		if(g_bufferCount != 0)
+		{
+			g_bufferTime = AUDIT_getEntryTime(g_buffer);
+		}
+	}
+	g_flushCount = 0;
+}
+
+uint8 AUDIT_read(uint16 *sequence, uint8 *data, uint8 maxEntries)
+{
+	uint16 oldest = g_storedSequence - g_storedCount;
+	uint16 count;
+	uint8 index;
+
+	if((sint16)(*sequence - oldest) < 0)
+	{
+		*sequence = oldest;
+	}
+	if((sint16)(g_nextSequence - *sequence) <= 0)
+	{
+		return 0;
+	}
+
+	if((sint16)(g_storedSequence - *sequence) > 0)
+	{
+		/* Entries in EEPROM, read by one sequential read up to the end of the area. */
+		count = g_storedSequence - *sequence;
+		index = (g_head + AUDIT_ENTRY_COUNT - count) % AUDIT_ENTRY_COUNT;
+		if(count > AUDIT_ENTRY_COUNT - index)
+		{
+			count = AUDIT_ENTRY_COUNT - index;
+		}
+		if(count > maxEntries)
+		{
+			count = maxEntries;
+		}
+		if(EEPROM_readBlock(AUDIT_LOG_ADDRESS + (uint16)index * AUDIT_ENTRY_SIZE, data,
+				count * AUDIT_ENTRY_SIZE) == ERROR)
+		{
+			return 0;
+		}
+	}
+	else
+	{
+		/* Entries in the buffer. */
+		index = *sequence - g_storedSequence;
+		count = g_bufferCount - index;
+		if(count > maxEntries)
+		{
+			count = maxEntries;
+		}
+		for(uint8 i = 0; i < count * AUDIT_ENTRY_SIZE; i++)
+		{
+			data[i] = g_buffer[index * AUDIT_ENTRY_SIZE + i];
+		}
+	}
+	*sequence += count;
+	return (uint8)count;
+}
+
+static uint8 AUDIT_calculateCrc(const uint8 *entry)
+{
+	uint8 crc = 0xFF;
+	for(uint8 i = 0; i < AUDIT_ENTRY_CRC; i++)
+	{
+		crc ^= entry[i];
+		for(uint8 bit = 0; bit < 8; bit++)
+		{
+			crc = (crc & 0x80) ? (uint8)((crc << 1) ^ 0x07) : (uint8)(crc << 1);
+		}
+	}
+	return crc;
+}
+
+static uint32 AUDIT_getEntryTime(const uint8 *entry)
+{
+	return ((uint32)entry[AUDIT_ENTRY_TIME] << 16) | ((uint32)entry[AUDIT_ENTRY_TIME + 1] << 8) |
+			entry[AUDIT_ENTRY_TIME + 2];
+}
@@ -0,0 +1,88 @@
+ /******************************************************************************
+ *
+ * Module: AUDIT LOG
+ *
+ * File Name: audit_log.h
+ *
+ * Description: Header file for the access log of the door, a circular log in the external
+ *              EEPROM filled from a RAM buffer by page writes.
+ *
+ * Author: Mohamed Khaled.
+ *
+ *******************************************************************************/
+
+#ifndef AUDIT_LOG_H_
+#define AUDIT_LOG_H_
+
+#include "std_types.h"
+#include "twi.h"
+#include "external_eeprom.h"
+#include "door_protocol.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/*
+ * The entries are written in turn to the area and the oldest ones are overwritten when it is full,
+ * the entry with the newest sequence number is the last one written. The area is the end of the memory.
+ */
+#define AUDIT_LOG_ADDRESS                 0x0500
+#define AUDIT_LOG_SIZE                    0x0300
+#define AUDIT_ENTRY_SIZE                  PROTOCOL_AUDIT_ENTRY_SIZE
+#define AUDIT_ENTRY_COUNT                 (AUDIT_LOG_SIZE / AUDIT_ENTRY_SIZE)
+
+/*
+ * Entries kept in RAM till they fill the current EEPROM page, so the page is written once.
+ * A partly filled page is written after AUDIT_FLUSH_DELAY_S seconds.
+ * New entries are dropped while the buffer is full, then they are counted by an AUDIT_EVENT_OVERFLOW entry.
+ */
+#define AUDIT_BUFFER_ENTRIES              4
+#define AUDIT_FLUSH_DELAY_S               2
+
+#if (((AUDIT_LOG_ADDRESS % EEPROM_PAGE_SIZE) != 0) || ((AUDIT_LOG_SIZE % EEPROM_PAGE_SIZE) != 0) || \
+		((EEPROM_PAGE_SIZE % AUDIT_ENTRY_SIZE) != 0))
+#error "The audit log must be made of whole EEPROM pages holding whole entries"
+#endif
+
+/*******************************************************************************
+ *                      Functions Prototypes                                   *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Finds the newest entry in EEPROM, the next entries are written after it.
+ * Returns ERROR if the EEPROM can't be read.
+ */
+uint8 AUDIT_init(void);
+
+/*
+ * Description :
+ * Adds an entry of the event done by the user at the time in seconds to the RAM buffer.
+ * The entries dropped before are recorded first by an AUDIT_EVENT_OVERFLOW entry.
+ */
+void AUDIT_record(uint8 event, uint8 user, uint32 time);
+
+/*
+ * Description :
+ * Starts writing the buffered entries of the current EEPROM page by transaction if the page is
+ * filled or the oldest entry waits for AUDIT_FLUSH_DELAY_S.
+ * Returns TRUE if the write is started, then AUDIT_endFlush must be called when the transaction ends.
+ */
+boolean AUDIT_startFlush(TWI_Transaction *transaction, uint32 time);
+
+/*
+ * Description :
+ * Removes the written entries from the buffer, they are written again by the next flush if the write failed.
+ */
+void AUDIT_endFlush(boolean written);
+
+/*
+ * Description :
+ * Reads up to maxEntries entries starting at the sequence, or at the oldest kept entry if it is older,
+ * from EEPROM or from the buffer. Sets the sequence to the one after the last entry read.
+ * Returns the number of entries read, 0 after the newest entry or if the EEPROM can't be read.
+ */
+uint8 AUDIT_read(uint16 *sequence, uint8 *data, uint8 maxEntries);
+
+#endif /* AUDIT_LOG_H_ */
@@ -0,0 +1,185 @@
+ /******************************************************************************
+ *
+ * Module: CREDENTIAL STORE
+ *
+ * File Name: credential_store.c
+ *
+ * Description: Source file for the saved password record of the door, rotated over
+ *              several EEPROM pages to spread their wear.
+ *
+ * Author: Mohamed Khaled.
+ *
+ *******************************************************************************/
+
+#include "credential_store.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/*
+ * Record: [marker, sequence MSB, sequence LSB, data, CRC-8 of the sequence and the data].
+ * The record with sequence s is written to slot (s % CREDENTIAL_SLOT_COUNT).
+ * The record is written with the marker erased, then the marker alone is written to commit it,
+ * so a power failure in the middle of the first write leaves a record that is never taken.
+ * The older firmware saved [flag, password] at the start of the area, its flag is never the marker.
+ */
+#define CREDENTIAL_MARKER                 0x5A
+#define CREDENTIAL_MARKER_ERASED          0xFF
+#define CREDENTIAL_RECORD_DATA            3
+#define CREDENTIAL_RECORD_CRC             (CREDENTIAL_RECORD_DATA + CREDENTIAL_DATA_SIZE)
+#define CREDENTIAL_RECORD_SIZE            (CREDENTIAL_RECORD_CRC + 1)
+#define CREDENTIAL_WRITES_PER_RECORD      2
+
+#if (CREDENTIAL_RECORD_SIZE > CREDENTIAL_SLOT_SIZE)
+#error "The credential record doesn't fit in its slot"
+#endif
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+
+/* Sequence number of the newest record, valid if g_recordFound is TRUE. */
+static uint16 g_sequence = 0;
+static boolean g_recordFound = FALSE;
+
+/* Record under writing, kept till the transaction ends. */
+static uint8 g_record[CREDENTIAL_RECORD_SIZE];
+
+/*******************************************************************************
+ *                      Private Functions Prototypes                           *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Returns the CRC-8 (polynomial 0x07) of the record bytes between the marker and the CRC byte.
+ */
+static uint8 CREDENTIAL_calculateCrc(const uint8 *record);
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+uint8 CREDENTIAL_load(uint8 *data)
+{
+	uint8 record[CREDENTIAL_RECORD_SIZE];
+	uint16 sequence;
+
+	g_recordFound = FALSE;
+	for(uint8 slot = 0; slot < CREDENTIAL_SLOT_COUNT; slot++)
+	{
+		if(EEPROM_readBlock(CREDENTIAL_AREA_ADDRESS + (uint16)slot * CREDENTIAL_SLOT_SIZE, record,
+				CREDENTIAL_RECORD_SIZE) == ERROR)
+		{
+			return ERROR;
+		}
+		sequence = ((uint16)record[1] << 8) | record[2];
+		/* A record is only valid in the slot of its sequence, after its commit and with its CRC. */
+		if((record[0] != CREDENTIAL_MARKER) || ((sequence % CREDENTIAL_SLOT_COUNT) != slot) ||
+				(record[CREDENTIAL_RECORD_CRC] != CREDENTIAL_calculateCrc(record)))
+		{
+			continue;
+		}
+		/* The sequences of the valid records are close to each other, so the comparison survives the wrap around. */
+		if(!g_recordFound || ((sint16)(sequence - g_sequence) > 0))
+		{
+			g_recordFound = TRUE;
+			g_sequence = sequence;
+			for(uint8 i = 0; i < CREDENTIAL_DATA_SIZE; i++)
+			{
+				data[i] = record[CREDENTIAL_RECORD_DATA + i];
+			}
+		}
+	}
+
+	if(g_recordFound)
+	{
+		return SUCCESS;
+	}
+	/* No record yet, take the password saved by the older firmware if there is one. */
+	if(EEPROM_readBlock(CREDENTIAL_AREA_ADDRESS, data, CREDENTIAL_DATA_SIZE) == ERROR)
+	{
+		return ERROR;
+	}
+	if(data[0] != LOGIC_HIGH)
+	{
+		data[0] = LOGIC_LOW;
+	}
+	return SUCCESS;
+}
+
+void CREDENTIAL_startSave(const uint8 *data, TWI_Transaction *transaction)
+{
+	/*
+	 * The first record has sequence 1, so slot 0 keeps the data of the older firmware till
+	 * a record is committed, and the write counts are known from the sequence.
+	 */
+	g_sequence = g_recordFound ? (uint16)(g_sequence + 1) : 1;
+	g_recordFound = TRUE;
+
+	g_record[0] = CREDENTIAL_MARKER_ERASED;
+	g_record[1] = (uint8)(g_sequence >> 8);
+	g_record[2] = (uint8)g_sequence;
+	for(uint8 i = 0; i < CREDENTIAL_DATA_SIZE; i++)
+	{
+		g_record[CREDENTIAL_RECORD_DATA + i] = data[i];
+	}
+	g_record[CREDENTIAL_RECORD_CRC] = CREDENTIAL_calculateCrc(g_record);
+	EEPROM_startWrite(transaction, CREDENTIAL_AREA_ADDRESS + (g_sequence % CREDENTIAL_SLOT_COUNT) * CREDENTIAL_SLOT_SIZE,
+			g_record, CREDENTIAL_RECORD_SIZE);
+}
+
+uint16 CREDENTIAL_getWriteCount(uint8 slot)
+{
+	uint16 records;
+
+	if(!g_recordFound || (slot >= CREDENTIAL_SLOT_COUNT))
+	{
+		return 0;
+	}
+	/* The sequences from 1 to g_sequence are written in turn, so slot 0 is first written by CREDENTIAL_SLOT_COUNT. */
+	if(slot == 0)
+	{
+		records = g_sequence / CREDENTIAL_SLOT_COUNT;
+	}
+	else if(g_sequence < slot)
+	{
+		records = 0;
+	}
+	else
+	{
+		records = (g_sequence - slot) / CREDENTIAL_SLOT_COUNT + 1;
+	}
+	/* Each record takes two write cycles of its page, the record and then its marker. */
+	return records * CREDENTIAL_WRITES_PER_RECORD;
+}
+
+void CREDENTIAL_startCommit(TWI_Transaction *transaction)
+{
+	g_record[0] = CREDENTIAL_MARKER;
+	EEPROM_startWrite(transaction, CREDENTIAL_AREA_ADDRESS + (g_sequence % CREDENTIAL_SLOT_COUNT) * CREDENTIAL_SLOT_SIZE,
+			g_record, 1);
+}
+
+uint16 CREDENTIAL_getDataAddress(void)
+{
+	if(!g_recordFound)
+	{
+		return CREDENTIAL_AREA_ADDRESS;
+	}
+	return CREDENTIAL_AREA_ADDRESS + (g_sequence % CREDENTIAL_SLOT_COUNT) * CREDENTIAL_SLOT_SIZE + CREDENTIAL_RECORD_DATA;
+}
+
+static uint8 CREDENTIAL_calculateCrc(const uint8 *record)
+{
+	uint8 crc = 0xFF;
+	for(uint8 i = 1; i < CREDENTIAL_RECORD_CRC; i++)
+	{
+		crc ^= record[i];
+		for(uint8 bit = 0; bit < 8; bit++)
+		{
+			crc = (crc & 0x80) ? (uint8)((crc << 1) ^ 0x07) : (uint8)(crc << 1);
+		}
+	}
+	return crc;
+}
@@ -0,0 +1,85 @@
+ /******************************************************************************
+ *
+ * Module: CREDENTIAL STORE
+ *
+ * File Name: credential_store.h
+ *
+ * Description: Header file for the saved password record of the door, rotated over
+ *              several EEPROM pages to spread their wear.
+ *
+ * Author: Mohamed Khaled.
+ *
+ *******************************************************************************/
+
+#ifndef CREDENTIAL_STORE_H_
+#define CREDENTIAL_STORE_H_
+
+#include "std_types.h"
+#include "twi.h"
+#include "external_eeprom.h"
+#include "door_protocol.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/*
+ * Each change of the saved password writes a new record to the next slot instead of rewriting
+ * the same cells, the newest committed record with a valid CRC is the valid one.
+ * The record under writing never shares its slot with the newest one, so the older record is
+ * still taken if the power fails before the commit. The first record is written to slot 1, so the
+ * data of the older firmware at the start of slot 0 is kept till a record is committed.
+ */
+#define CREDENTIAL_AREA_ADDRESS           0x0000
+#define CREDENTIAL_SLOT_COUNT             16
+#define CREDENTIAL_SLOT_SIZE              EEPROM_PAGE_SIZE
+
+/* Data of the record: [saved password flag, password]. */
+#define CREDENTIAL_DATA_SIZE              (PASSWORD_LENGTH + 1)
+
+#if ((CREDENTIAL_AREA_ADDRESS % EEPROM_PAGE_SIZE) != 0)
+#error "CREDENTIAL_AREA_ADDRESS must be at the start of an EEPROM page"
+#endif
+
+/*******************************************************************************
+ *                      Functions Prototypes                                   *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Finds the newest record and copies its data, or the data saved by the older firmware at
+ * the start of the area if there is no record yet.
+ * Returns ERROR if the EEPROM can't be read.
+ */
+uint8 CREDENTIAL_load(uint8 *data);
+
+/*
+ * Description :
+ * Starts writing the data as a new uncommitted record in the slot after the newest one.
+ * The transaction must stay valid till it ends, then the write cycle of the EEPROM starts.
+ */
+void CREDENTIAL_startSave(const uint8 *data, TWI_Transaction *transaction);
+
+/*
+ * Description :
+ * Starts writing the marker of the record saved by CREDENTIAL_startSave, the record becomes
+ * the valid one by this single byte write. It must start after the write cycle of the record.
+ */
+void CREDENTIAL_startCommit(TWI_Transaction *transaction);
+
+/*
+ * Description :
+ * Returns the number of write cycles of the slot page, two for each record written to it by the
+ * record and its commit. It is known from the sequence number of the newest record as the slots
+ * are written in turn.
+ */
+uint16 CREDENTIAL_getWriteCount(uint8 slot);
+
+/*
+ * Description :
+ * Returns the EEPROM address of the data of the newest record found by CREDENTIAL_load or written
+ * by CREDENTIAL_startSave, or the start of the area if the data is saved by the older firmware.
+ */
+uint16 CREDENTIAL_getDataAddress(void);
+
+#endif /* CREDENTIAL_STORE_H_ */
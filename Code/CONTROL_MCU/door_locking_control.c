@@ -16,37 +16,84 @@
 #define F_CPU 8000000
 
 #include <avr/io.h>
+#include <avr/interrupt.h> /* For cli() */
 #include "std_types.h"
 #include "uart.h"
 #include "external_eeprom.h"
+#include "twi.h"
 #include "gpio.h"
 #include "dc_motor.h"
 #include "buzzer.h"
 #include "delay.h"
+#include "timer.h"
+#include "sw_timer.h"
+#include "scheduler.h"
+#include "power.h"
+#include "link.h"
+#include "user_store.h"
+#include "credential_store.h"
+#include "audit_log.h"
+#include "door_protocol.h"
 
-/* This messages are used for MCUs hand shaking. */
-#define CONTROL_MCU_READY 								 0x10
-#define HMI_MCU_READY									 0xff
+/* Address of this door controller on the multi-drop bus, must be unique for each control MCU. */
+#define CONTROL_NODE_ADDRESS							 0x01
 
-/* Commands that can be handled by control MCU. */
-#define CONTROL_COMPARE_TWO_PASSWORDS					 0x01
-#define CONTROL_CHECK_PASSWORD_LENGTH  					 0x02
-#define CONTROL_CHECK_SAVED_PASSWORD_FLAG 				 0x03
-#define CONTROL_ERASE_SAVED_PASSWORD					 0x04
-#define CHECK_PASSWORD_WITH_SAVED_PASSWORD				 0x05
-#define CONTROL_MOTOR_ROTATE_CW							 0x06
-#define CONTROL_MOTOR_STOP 								 0x07
-#define CONTROL_MOTOR_ROTATE_CCW						 0x08
-#define CONTROL_BUZZER_ON 								 0X09
-#define CONTROL_BUZZER_OFF								 0X0A
+/* Areas of the external EEPROM, they must not overlap. */
+#if (CREDENTIAL_AREA_ADDRESS + CREDENTIAL_SLOT_COUNT * CREDENTIAL_SLOT_SIZE > USER_TABLE_ADDRESS)
+#error "The credential area overlaps the user table"
+#endif
+#if (USER_TABLE_ADDRESS + USER_MAX_COUNT * USER_RECORD_SIZE > AUDIT_LOG_ADDRESS)
+#error "The user table overlaps the audit log"
+#endif
 
-#define COMPARE_RESULT_TRUE 0x01
-#define COMPARE_RESULT_FALSE 0x00
-#define PASSWORD_LENGTH								   	5
+/* Capabilities reported to HMI MCU in the CONTROL_HELLO response. */
+#define CONTROL_CAPABILITIES							 (PROTOCOL_CAP_LOCAL_LENGTH_CHECK | \
+														  PROTOCOL_CAP_VERIFY_AND_CYCLE | \
+														  PROTOCOL_CAP_BLOCK_EEPROM | \
+														  PROTOCOL_CAP_MULTI_USER | \
+														  PROTOCOL_CAP_WEAR_STATS | \
+														  PROTOCOL_CAP_AUDIT_LOG | \
+														  PROTOCOL_CAP_POWER_STATS)
 
-/* Start address of saved data in EEPROM. */
-#define SAVED_PASSWORD_FLAG_ADDRESS   					 0x0000
-#define PASSWORD_START_ADDRESS							 0x0001
+/* Requests accessing EEPROM waiting to be executed, one for each outstanding request of HMI MCU. */
+#define EEPROM_JOB_QUEUE_SIZE							 PROTOCOL_MAX_OUTSTANDING_REQUESTS
+/* Buffers for the frames received by the UART RX ISR, one of them is always under reception. */
+#define CONTROL_FRAME_POOL_SIZE							 3
+/* Last responses kept to answer the retransmitted requests, one for each outstanding request. */
+#define RESPONSE_CACHE_SIZE								 PROTOCOL_MAX_OUTSTANDING_REQUESTS
+
+/* Events of the scheduler by priority, the requests are served first. */
+#define CONTROL_EVENT_FRAME								 0
+#define CONTROL_EVENT_BAUD_TIMEOUT						 1
+#define CONTROL_EVENT_DOOR								 2
+#define CONTROL_EVENT_EEPROM							 3
+#define CONTROL_EVENT_SERVICE							 4
+/* Period of the link state and link errors checks and of the access log flush check. */
+#define CONTROL_SERVICE_PERIOD_MS						 20
+
+/*************************** UNCOMMENT the next line to measure the EEPROM reads at startup ***************************/
+/*
+#define CONTROL_EEPROM_BENCHMARK
+*/
+/* Reads of the saved password done by the benchmark by each method. */
+#define BENCHMARK_RUNS									 50
+
+
+/***********************************************************************
+ *                          User Defined Types                         *
+ ***********************************************************************/
+/*
+ * Description:
+ * Request that accesses EEPROM, it is executed in steps of one EEPROM write each,
+ * so the fast requests received meanwhile are answered before it.
+ */
+typedef struct
+{
+	LINK_FrameType request;
+	uint8 step;
+	/* Result kept between the steps, as the slot of the added user. */
+	uint8 result;
+}EepromJob;
 
 
 /***********************************************************************
@@ -54,286 +101,1526 @@
  ***********************************************************************/
 /*
  * Description:
- * Checks the validity of password and re-entered password and save password if valid.
+ * Compares the received password and re-entered password.
+ * Returns the result of comparison.
+ */
+uint8 checkNewPassword( const uint8* passwords );
+/*
+ * Description:
+ * This function translates the received request frame to the corresponding function
+ * and fills the response frame with the result.
+ */
+void performCommand( const LINK_FrameType* request, LINK_FrameType* response );
+/*
+ * Description:
+ * Writes the password with the saved password flag set to LOGIC_HIGH in the first steps.
+ * Returns TRUE when the record is committed or its write failed.
+ */
+boolean savePasswordStep( const uint8* password, uint8 step );
+/*
+ * Description:
+ * Writes the credentials cache as a new record in the first step and commits it in the second one.
+ * Returns TRUE when the record is committed or its write failed.
+ */
+boolean saveCredentialsStep( uint8 step );
+/*
+ * Description:
+ * Check the length of password, returns TRUE if it is valid.
+ */
+uint8 checkPasswordLength( uint8 length );
+/*
+ * Description:
+ * Returns the status of saved password flag.
+ */
+uint8 checkSavedPassword( void );
+/*
+ * Description:
+ * Reads the saved password flag and the password from EEPROM to the credentials cache.
+ */
+void loadCredentials( void );
+/*
+ * Description:
+ * Reloads the credentials cache if it is not loaded or its CRC doesn't match its data.
+ * Returns TRUE if the cache is valid.
+ */
+boolean validateCredentials( void );
+/*
+ * Description:
+ * Calculates CRC-8 (polynomial 0x07) of the credentials cache.
+ */
+uint8 calculateCredentialsCrc( void );
+/*
+ * Description:
+ * Erases the EEPROM password by erasing the flag that keeps status either there is a saved password or not.
+ * Returns TRUE when the record is committed or its write failed.
+ */
+boolean eraseSavedPasswordStep( uint8 step );
+/*
+ * Description:
+ * This function is executed when the HMI controller sends CHECK_PASSWORD_WITH_SAVED_PASSWORD command.
+ * It compares the received password with saved password in the credentials cache and returns the result,
+ * which is always COMPARE_RESULT_FALSE if there is no saved password.
+ */
+uint8 checkPassword( const uint8* enteredPassword );
+/*
+ * Description:
+ * Turns the motor clock wise.
+ */
+void openDoor( void );
+/*
+ * Description:
+ * Turns the motor anti clock wise.
+ */
+void closeDoor( void );
+/*
+ * Description:
+ * Stops the motor.
+ */
+void stopDoor( void );
+/*
+ * Description:
+ * Returns TRUE if the payload length of the request is the expected one for its command.
+ */
+boolean checkRequestLength( const LINK_FrameType* request );
+/*
+ * Description:
+ * Returns TRUE if the request command reads or writes EEPROM.
+ */
+boolean isEepromCommand( uint8 command );
+/*
+ * Description:
+ * Returns TRUE if the command reads the saved password or its flag.
+ */
+boolean isCredentialCommand( uint8 command );
+/*
+ * Description:
+ * Adds the request to the EEPROM jobs queue, answers it by PROTOCOL_STATUS_BUSY if the queue is full.
+ */
+void queueEepromJob( const LINK_FrameType* request );
+/*
+ * Description:
+ * Handler of CONTROL_EVENT_EEPROM, executes the next step of the oldest EEPROM job or writes the
+ * access log if the last EEPROM write is finished, and sends the job response when it is done.
+ */
+void processEepromJob( void );
+/*
+ * Description:
+ * Executes one step of the EEPROM job and fills the response frame when the job is done.
+ * Returns TRUE when the job is done.
+ */
+boolean performJobStep( EepromJob* job, LINK_FrameType* response );
+/*
+ * Description:
+ * Sends the next access log entries requested by CONTROL_READ_AUDIT_LOG in one CONTROL_AUDIT_ENTRIES frame.
+ * The position in the log is kept in the request payload and the number of entries sent in the job result.
+ * Returns FALSE if there is no entry left.
+ */
+boolean sendAuditEntries( EepromJob* job );
+/*
+ * Description:
+ * Adds the event to the access log, it is written to EEPROM later between the EEPROM jobs.
+ */
+void recordEvent( uint8 event, uint8 user );
+/*
+ * Description:
+ * Returns the time in seconds since the boot.
+ */
+uint32 getUptime( void );
+/*
+ * Description:
+ * Executes one request frame and sends its response frame to HMI MCU.
+ * Broadcast requests are executed by all control MCUs and never answered.
+ */
+void handleRequest( const LINK_FrameType* request );
+/*
+ * Description:
+ * Queues the received request if it accesses EEPROM, otherwise executes it immediately.
+ */
+void dispatchRequest( const LINK_FrameType* request );
+/*
+ * Description:
+ * Accepts the baud rate requested by CONTROL_SET_BAUD_RATE if it is valid at F_CPU.
+ * The rate is applied after sending the response.
+ */
+uint8 requestBaudRate( const uint8* rate );
+/*
+ * Description:
+ * Switches UART to the accepted baud rate, the next frame received at the new rate confirms it.
+ */
+void switchBaudRate( void );
+/*
+ * Description:
+ * Handler of CONTROL_EVENT_BAUD_TIMEOUT, goes back to the old rate if the new one isn't confirmed.
+ */
+void baudRateTimeout( void );
+/*
+ * Description:
+ * Handler of CONTROL_EVENT_FRAME, serves all the received requests.
+ */
+void handleFrames( void );
+/*
+ * Description:
+ * Handler of CONTROL_EVENT_SERVICE, checks the link and starts the access log flush if it is due.
+ */
+void serviceControl( void );
+/*
+ * Description:
+ * Called by the UART RX ISR when a frame is received, posts CONTROL_EVENT_FRAME.
+ */
+void frameReceived( void );
+/*
+ * Description:
+ * Called by the TWI ISR when an EEPROM transaction ends, posts CONTROL_EVENT_EEPROM.
+ */
+void eepromTransactionDone( void );
+/*
+ * Description:
+ * Callback of the service timer, posts CONTROL_EVENT_SERVICE.
+ */
+void serviceTimerExpired( void );
+/*
+ * Description:
+ * Callback of the baud rate timer, posts CONTROL_EVENT_BAUD_TIMEOUT.
+ */
+void baudTimerExpired( void );
+/*
+ * Description:
+ * Starts the open/hold/close door cycle, the cycle is continued by the door timer.
+ */
+void startDoorCycle( uint8 sequence );
+/*
+ * Description:
+ * Called by the system tick each 1 ms, counts the time, runs the link and TWI timeouts
+ * and runs the EEPROM jobs again while they wait for the EEPROM.
+ */
+void controlTick( void );
+/*
+ * Description:
+ * Idle handler of the scheduler, sleeps until the next event, the tick isn't stretched while
+ * the EEPROM jobs wait for the EEPROM.
+ */
+void enterIdle( void );
+/*
+ * Description:
+ * Callback of the door timer, moves the door cycle to the next state when the current one ends
+ * and posts CONTROL_EVENT_DOOR to report it.
+ */
+void doorTimerExpired( void );
+/*
+ * Description:
+ * Handler of CONTROL_EVENT_DOOR, sends CONTROL_DOOR_EVENT frame to HMI MCU if the door state
+ * changed since the last report.
+ */
+void reportDoorState( void );
+/*
+ * Description:
+ * Goes back to the boot baud rate when HMI MCU is silent for LINK_PEER_TIMEOUT_MS,
+ * so a restarted HMI MCU can reach this controller again.
+ */
+void checkLinkState( void );
+/*
+ * Description:
+ * Sends the response to HMI MCU and keeps it to answer a retransmission of the same request.
+ */
+void sendResponse( const LINK_FrameType* response );
+/*
+ * Description:
+ * Answers a retransmitted request by its saved response, or by CONTROL_ACK if it is still queued.
+ * Returns TRUE if the request is a retransmission.
+ */
+boolean handleRetransmission( const LINK_FrameType* request );
+/*
+ * Description:
+ * Sends CONTROL_ACK for the request queued in the EEPROM jobs queue.
+ */
+void sendAck( const LINK_FrameType* request );
+/*
+ * Description:
+ * Sends CONTROL_NACK if the link dropped a frame since the last check,
+ * so HMI MCU retransmits its pending requests without waiting for the timeout.
+ */
+void checkLinkErrors( void );
+#ifdef CONTROL_EEPROM_BENCHMARK
+/*
+ * Description:
+ * Reads the saved password of the loaded credential record BENCHMARK_RUNS times byte by byte
+ * then by one block read, and saves the TWI bytes and the time in us taken by each method.
+ */
+void benchmarkPasswordRead( void );
+#endif
+
+
+/***********************************************************************
+ *                            Global Variables                          *
+ ***********************************************************************/
+/* Current state of the door cycle, changed by the door timer callback. */
+volatile uint8 g_doorState = DOOR_STATE_CLOSED;
+/* Last door state sent to HMI MCU. */
+uint8 g_reportedDoorState = DOOR_STATE_CLOSED;
+/* Software timers that end each state of the door cycle, run the periodic checks and end the baud rate confirmation. */
+SWTIMER_Handle g_doorTimer = SWTIMER_INVALID_HANDLE;
+SWTIMER_Handle g_serviceTimer = SWTIMER_INVALID_HANDLE;
+SWTIMER_Handle g_baudTimer = SWTIMER_INVALID_HANDLE;
+/* Sequence of the request that started the current door cycle. */
+uint8 g_doorCycleSequence = 0;
+/* Current UART baud rate and the rate accepted by the last CONTROL_SET_BAUD_RATE, 0 if none. */
+uint32 g_baudRate = PROTOCOL_BOOT_BAUD_RATE;
+uint32 g_pendingBaudRate = 0;
+/* Set while UART is at g_pendingBaudRate waiting for the confirmation. */
+boolean g_baudRateSwitched = FALSE;
+/* Time in ms incremented by the system tick, 8 bits are enough for the short waits and it is read atomically. */
+volatile uint8 g_tickCount = 0;
+/* Requests accessing EEPROM, executed in the order of reception. */
+EepromJob g_eepromJobs[EEPROM_JOB_QUEUE_SIZE];
+uint8 g_eepromJobHead = 0;
+uint8 g_eepromJobCount = 0;
+/* Time of the last EEPROM write, valid while g_eepromWriting is TRUE. */
+uint8 g_eepromWriteTick = 0;
+boolean g_eepromWriting = FALSE;
+/* Last EEPROM write of the jobs and of the access log, executed by the TWI ISR. */
+TWI_Transaction g_eepromTransaction;
+TWI_Transaction g_auditTransaction;
+/* TRUE if the last EEPROM write is a flush of the access log, it is cleared when the flush ends. */
+boolean g_auditFlushing = FALSE;
+/* TRUE if the access log is written after the last job step, then the next write is a job step. */
+boolean g_auditFlushed = FALSE;
+/* Time since the boot in seconds, and the ms counted in the current second. */
+volatile uint32 g_uptime = 0;
+uint16 g_uptimeMs = 0;
+/*
+ * Write through cache of the saved password flag followed by the password, as in the newest credential record.
+ * The CRC detects a cache corrupted in RAM, then the cache is loaded again.
+ */
+uint8 g_credentials[CREDENTIAL_DATA_SIZE];
+uint8 g_credentialsCrc = 0;
+boolean g_credentialsLoaded = FALSE;
+/* Received frames, assembled in place by the link receiver. */
+LINK_FrameType g_framePool[CONTROL_FRAME_POOL_SIZE];
+/* Link state seen by the last checkLinkState. */
+LINK_StateType g_linkState = LINK_DOWN;
+/* Last responses sent and their sending times, an empty entry has command 0. */
+LINK_FrameType g_responseCache[RESPONSE_CACHE_SIZE];
+uint16 g_responseTime[RESPONSE_CACHE_SIZE];
+uint8 g_responseCacheNext = 0;
+/* Number of dropped frames seen by the last checkLinkErrors. */
+uint16 g_linkErrorCount = 0;
+#ifdef CONTROL_EEPROM_BENCHMARK
+/* Results of benchmarkPasswordRead to be read by the debugger, index 0: byte reads, 1: block reads. */
+uint16 g_benchmarkTransfers[2];
+uint32 g_benchmarkTimeUs[2];
+#endif
+
+
+/***********************************************************************
+ *                       Functions Implementation                      *
+ ***********************************************************************/
+int main ( void )
+{
+	/* Enable global interrupt. */
+	SREG |= (1<<7);
+	/* Delay to let UART in the other MCU to be initialized */
+	EEPROM_init();
+	delay_ms(1);
+	/* 9-bit data for the multi-processor communication mode of the shared bus. */
+	UART_ConfigType config = {PROTOCOL_BOOT_BAUD_RATE,BITS_9,NO_PARITY,ONE_STOP_BIT,UART_INTERRUPT_MODE};
+	UART_init(&config);
+	DcMotor_Init();
+	BUZZER_Init();
+
+	/*
+	 * The door states are timed by the software timers on the system tick of timer 1, which counts
+	 * the 1 ms time of the EEPROM writes and link timeouts too, so the CPU sleeps between the events.
+	 */
+	SWTIMER_init();
+	SWTIMER_setTickCallBack(controlTick);
+	POWER_init();
+	g_doorTimer = SWTIMER_create(doorTimerExpired);
+	g_serviceTimer = SWTIMER_create(serviceTimerExpired);
+	g_baudTimer = SWTIMER_create(baudTimerExpired);
+	/* The password checks are served from RAM, EEPROM is only accessed to change the password. */
+	loadCredentials();
+#ifdef CONTROL_EEPROM_BENCHMARK
+	benchmarkPasswordRead();
+#endif
+	USER_init();
+	AUDIT_init();
+	recordEvent(AUDIT_EVENT_BOOT, PROTOCOL_USER_NONE);
+
+	LINK_init(CONTROL_NODE_ADDRESS);
+	LINK_setFramePool(g_framePool, CONTROL_FRAME_POOL_SIZE);
+
+	/*
+	 * Every HMI MCU request is answered by one response.
+	 * Requests accessing EEPROM are queued and executed step by step, the other requests are
+	 * answered immediately, so responses may be sent out of order.
+	 * Each handler runs to completion, so a request waits for one handler at most.
+	 */
+	SCHEDULER_init();
+	SCHEDULER_setHandler(CONTROL_EVENT_FRAME, handleFrames);
+	SCHEDULER_setHandler(CONTROL_EVENT_BAUD_TIMEOUT, baudRateTimeout);
+	SCHEDULER_setHandler(CONTROL_EVENT_DOOR, reportDoorState);
+	SCHEDULER_setHandler(CONTROL_EVENT_EEPROM, processEepromJob);
+	SCHEDULER_setHandler(CONTROL_EVENT_SERVICE, serviceControl);
+	SCHEDULER_setIdleHandler(enterIdle);
+	LINK_setFrameCallBack(frameReceived);
+	TWI_setDoneCallBack(eepromTransactionDone);
+	SWTIMER_start(g_serviceTimer, CONTROL_SERVICE_PERIOD_MS, CONTROL_SERVICE_PERIOD_MS);
+	/* Frames received before the callback is set are served by the first event. */
+	SCHEDULER_post(CONTROL_EVENT_FRAME);
+	SCHEDULER_run();
+
+	return 0;
+}
+
+
+/*
+ * Description:
+ * Handler of CONTROL_EVENT_FRAME, serves all the received requests.
+ */
+void handleFrames( void )
+{
+	LINK_FrameType* request;
+
+	while((request = LINK_getFrame()) != NULL_PTR)
+	{
+		/* The new baud rate is confirmed by the next request received at this rate. */
+		if(g_baudRateSwitched)
+		{
+			SWTIMER_stop(g_baudTimer);
+			g_baudRateSwitched = FALSE;
+			g_baudRate = g_pendingBaudRate;
+			g_pendingBaudRate = 0;
+		}
+		/* The request is used in place, the jobs queue keeps its own copy. */
+		dispatchRequest(request);
+		LINK_releaseFrame();
+		if((g_pendingBaudRate != 0) && !g_baudRateSwitched)
+		{
+			switchBaudRate();
+		}
+	}
+	checkLinkState();
+	checkLinkErrors();
+}
+
+
+/*
+ * Description:
+ * Handler of CONTROL_EVENT_SERVICE, checks the link and starts the access log flush if it is due.
+ */
+void serviceControl( void )
+{
+	checkLinkState();
+	checkLinkErrors();
+	SCHEDULER_post(CONTROL_EVENT_EEPROM);
+}
+
+
+/*
+ * Description:
+ * Called by the UART RX ISR when a frame is received, posts CONTROL_EVENT_FRAME.
+ */
+void frameReceived( void )
+{
+	SCHEDULER_post(CONTROL_EVENT_FRAME);
+}
+
+
+/*
+ * Description:
+ * Called by the TWI ISR when an EEPROM transaction ends, posts CONTROL_EVENT_EEPROM.
+ */
+void eepromTransactionDone( void )
+{
+	SCHEDULER_post(CONTROL_EVENT_EEPROM);
+}
+
+
+/*
+ * Description:
+ * Callback of the service timer, posts CONTROL_EVENT_SERVICE.
+ */
+void serviceTimerExpired( void )
+{
+	SCHEDULER_post(CONTROL_EVENT_SERVICE);
+}
+
+
+/*
+ * Description:
+ * Callback of the baud rate timer, posts CONTROL_EVENT_BAUD_TIMEOUT.
+ */
+void baudTimerExpired( void )
+{
+	SCHEDULER_post(CONTROL_EVENT_BAUD_TIMEOUT);
+}
+
+
+/*
+ * Description:
+ * This function translates the received request frame to the corresponding function
+ * and fills the response frame with the result.
+ */
+void performCommand( const LINK_FrameType* request, LINK_FrameType* response )
+{
+	response->address = CONTROL_NODE_ADDRESS;
+	response->command = request->command | PROTOCOL_RESPONSE_FLAG;
+	response->sequence = request->sequence;
+	response->length = 1;
+	response->payload[0] = PROTOCOL_STATUS_OK;
+
+	if(!checkRequestLength(request))
+	{
+		response->payload[0] = PROTOCOL_STATUS_BAD_LENGTH;
+		return;
+	}
+
+	/* The motor is owned by the door cycle till it finishes. */
+	if((g_doorState != DOOR_STATE_CLOSED) && ((request->command == CONTROL_MOTOR_ROTATE_CW) ||
+			(request->command == CONTROL_MOTOR_ROTATE_CCW) || (request->command == CONTROL_MOTOR_STOP) ||
+			(request->command == CONTROL_VERIFY_AND_CYCLE_DOOR)))
+	{
+		response->payload[0] = PROTOCOL_STATUS_BUSY;
+		return;
+	}
+
+	switch(request->command)
+	{
+	case CONTROL_CHECK_PASSWORD_LENGTH:
+		response->payload[response->length++] = checkPasswordLength(request->payload[0]);
+		break;
+	case CONTROL_CHECK_SAVED_PASSWORD_FLAG:
+		response->payload[response->length++] = checkSavedPassword();
+		break;
+	case CHECK_PASSWORD_WITH_SAVED_PASSWORD:
+		response->payload[response->length] = checkPassword(request->payload);
+		recordEvent((response->payload[response->length] == COMPARE_RESULT_TRUE) ? AUDIT_EVENT_PASSWORD_ACCEPTED :
+				AUDIT_EVENT_PASSWORD_REJECTED, PROTOCOL_USER_SAVED_PASSWORD);
+		response->length++;
+		break;
+	case CONTROL_VERIFY_AND_CYCLE_DOOR:
+	{
+		uint8 user = PROTOCOL_USER_SAVED_PASSWORD;
+		response->payload[response->length] = checkPassword(request->payload);
+		/* The users open the door by their own passwords too. */
+		if(response->payload[response->length] == COMPARE_RESULT_FALSE)
+		{
+			user = USER_find(request->payload);
+			if(user != USER_SLOT_NONE)
+			{
+				response->payload[response->length] = COMPARE_RESULT_TRUE;
+			}
+		}
+		if(response->payload[response->length] == COMPARE_RESULT_TRUE)
+		{
+			startDoorCycle(request->sequence);
+			recordEvent(AUDIT_EVENT_UNLOCK, user);
+		}
+		else
+		{
+			recordEvent(AUDIT_EVENT_PASSWORD_REJECTED, PROTOCOL_USER_NONE);
+		}
+		response->length++;
+		break;
+	}
+	case CONTROL_MOTOR_ROTATE_CW:
+		/* Opened by HMI MCU after its own password check. */
+		openDoor();
+		recordEvent(AUDIT_EVENT_UNLOCK, PROTOCOL_USER_NONE);
+		break;
+	case CONTROL_MOTOR_STOP:
+		stopDoor();
+		break;
+	case CONTROL_MOTOR_ROTATE_CCW:
+		closeDoor();
+		break;
+	case CONTROL_BUZZER_ON:
+		/* HMI MCU starts the buzzer after the third wrong password. */
+		BUZZER_On();
+		recordEvent(AUDIT_EVENT_LOCKOUT, PROTOCOL_USER_NONE);
+		break;
+	case CONTROL_BUZZER_OFF:
+		BUZZER_Off();
+		break;
+	case CONTROL_SET_BAUD_RATE:
+		response->payload[response->length++] = requestBaudRate(request->payload);
+		break;
+	case CONTROL_PING:
+		break;
+	case CONTROL_VERIFY_USER:
+		response->payload[response->length] = USER_find(request->payload);
+		if(response->payload[response->length] != USER_SLOT_NONE)
+		{
+			recordEvent(AUDIT_EVENT_PASSWORD_ACCEPTED, response->payload[response->length]);
+		}
+		else
+		{
+			recordEvent(AUDIT_EVENT_PASSWORD_REJECTED, PROTOCOL_USER_NONE);
+		}
+		response->length++;
+		break;
+	case CONTROL_GET_WEAR_STATS:
+		/* Write counts of the credential slots starting at the requested one, as many as fit in the frame. */
+		response->payload[response->length++] = request->payload[0];
+		for (uint8 slot = request->payload[0];
+				(slot < CREDENTIAL_SLOT_COUNT) && (response->length + 2 <= LINK_MAX_PAYLOAD_LENGTH); slot++)
+		{
+			uint16 count = CREDENTIAL_getWriteCount(slot);
+			response->payload[response->length++] = (uint8)(count >> 8);
+			response->payload[response->length++] = (uint8)count;
+		}
+		break;
+	case CONTROL_GET_POWER_STATS:
+	{
+		uint16 sleepRatio = POWER_getSleepRatio();
+		response->payload[response->length++] = (uint8)(sleepRatio >> 8);
+		response->payload[response->length++] = (uint8)sleepRatio;
+		break;
+	}
+	case CONTROL_HELLO:
+		response->payload[response->length++] = PROTOCOL_VERSION;
+		response->payload[response->length++] = CONTROL_CAPABILITIES;
+		break;
+	default:
+		response->payload[0] = PROTOCOL_STATUS_UNKNOWN_COMMAND;
+		break;
+	}
+}
+
+
+/*
+ * Description:
+ * Returns TRUE if the payload length of the request is the expected one for its command.
+ */
+boolean checkRequestLength( const LINK_FrameType* request )
+{
+	/* Expected payload length of the request. */
+	uint8 expectedLength = 0;
+
+	switch(request->command)
+	{
+	case CONTROL_COMPARE_TWO_PASSWORDS:
+	case CONTROL_ADD_USER:
+		expectedLength = 2 * PASSWORD_LENGTH;
+		break;
+	case CONTROL_REMOVE_USER:
+		expectedLength = PASSWORD_LENGTH + 1;
+		break;
+	case CONTROL_READ_AUDIT_LOG:
+		expectedLength = 2;
+		break;
+	case CONTROL_CHECK_PASSWORD_LENGTH:
+	case CONTROL_HELLO:
+	case CONTROL_GET_WEAR_STATS:
+		expectedLength = 1;
+		break;
+	case CONTROL_SET_BAUD_RATE:
+		expectedLength = 4;
+		break;
+	case CHECK_PASSWORD_WITH_SAVED_PASSWORD:
+	case CONTROL_VERIFY_AND_CYCLE_DOOR:
+	case CONTROL_VERIFY_USER:
+		expectedLength = PASSWORD_LENGTH;
+		break;
+	default:
+		break;
+	}
+	return (request->length == expectedLength);
+}
+
+
+/*
+ * Description:
+ * Returns TRUE if the request command reads or writes EEPROM.
+ */
+boolean isEepromCommand( uint8 command )
+{
+	switch(command)
+	{
+	case CONTROL_COMPARE_TWO_PASSWORDS:
+	case CONTROL_ERASE_SAVED_PASSWORD:
+	case CONTROL_ADD_USER:
+	case CONTROL_REMOVE_USER:
+	case CONTROL_READ_AUDIT_LOG:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+
+/*
+ * Description:
+ * Returns TRUE if the command reads the saved password or its flag.
+ */
+boolean isCredentialCommand( uint8 command )
+{
+	switch(command)
+	{
+	case CONTROL_CHECK_SAVED_PASSWORD_FLAG:
+	case CHECK_PASSWORD_WITH_SAVED_PASSWORD:
+	case CONTROL_VERIFY_AND_CYCLE_DOOR:
+	case CONTROL_VERIFY_USER:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+
+/*
+ * Description:
+ * Adds the request to the EEPROM jobs queue, answers it by PROTOCOL_STATUS_BUSY if the queue is full.
+ */
+void queueEepromJob( const LINK_FrameType* request )
+{
+	if(g_eepromJobCount == EEPROM_JOB_QUEUE_SIZE)
+	{
+		LINK_FrameType response;
+		response.address = CONTROL_NODE_ADDRESS;
+		response.command = request->command | PROTOCOL_RESPONSE_FLAG;
+		response.sequence = request->sequence;
+		response.length = 1;
+		response.payload[0] = PROTOCOL_STATUS_BUSY;
+		if(request->address != LINK_BROADCAST_ADDRESS)
+		{
+			sendResponse(&response);
+		}
+		return;
+	}
+	EepromJob* job = &g_eepromJobs[(g_eepromJobHead + g_eepromJobCount) % EEPROM_JOB_QUEUE_SIZE];
+	job->request = *request;
+	job->step = 0;
+	g_eepromJobCount++;
+	SCHEDULER_post(CONTROL_EVENT_EEPROM);
+	if(request->address != LINK_BROADCAST_ADDRESS)
+	{
+		sendAck(request);
+	}
+}
+
+
+/*
+ * Description:
+ * Handler of CONTROL_EVENT_EEPROM, executes the next step of the oldest EEPROM job or writes the
+ * access log if the last EEPROM write is finished, and sends the job response when it is done.
+ */
+void processEepromJob( void )
+{
+	/*
+	 * The write is sent by the TWI ISR while the link is serviced, then the EEPROM doesn't acknowledge
+	 * its address during its write cycle, the next step starts as soon as it does.
+	 * A device that is still busy after the maximum cycle time is not waited any more.
+	 */
+	if(g_eepromWriting)
+	{
+		if((g_auditFlushing ? g_auditTransaction.result : g_eepromTransaction.result) == TWI_PENDING)
+		{
+			return;
+		}
+		if(g_auditFlushing)
+		{
+			AUDIT_endFlush(g_auditTransaction.result == TWI_DONE);
+			g_auditFlushing = FALSE;
+		}
+		/* The cache may not match EEPROM any more, it is read again when it is used. */
+		else if(g_eepromTransaction.result != TWI_DONE)
+		{
+			g_credentialsLoaded = FALSE;
+		}
+		if(EEPROM_isBusy() && ((uint8)(g_tickCount - g_eepromWriteTick) <= EEPROM_WRITE_CYCLE_MS))
+		{
+			return;
+		}
+		g_eepromWriting = FALSE;
+	}
+
+	/*
+	 * The access log is written between the job steps too, so it isn't filled up by a long job,
+	 * and the log and the job steps take turns, so a job step waits for one write at most.
+	 */
+	if(((g_eepromJobCount == 0) || !g_auditFlushed) && AUDIT_startFlush(&g_auditTransaction, getUptime()))
+	{
+		g_auditFlushing = TRUE;
+		g_auditFlushed = TRUE;
+		g_eepromWriteTick = g_tickCount;
+		g_eepromWriting = TRUE;
+		return;
+	}
+	g_auditFlushed = FALSE;
+	if(g_eepromJobCount == 0)
+	{
+		return;
+	}
+
+	EepromJob* job = &g_eepromJobs[g_eepromJobHead];
+	LINK_FrameType response;
+	if(!performJobStep(job, &response))
+	{
+		return;
+	}
+	if(job->request.address != LINK_BROADCAST_ADDRESS)
+	{
+		sendResponse(&response);
+	}
+	g_eepromJobHead = (g_eepromJobHead + 1) % EEPROM_JOB_QUEUE_SIZE;
+	g_eepromJobCount--;
+	/* The next job starts without waiting for the tick. */
+	if(g_eepromJobCount > 0)
+	{
+		SCHEDULER_post(CONTROL_EVENT_EEPROM);
+	}
+}
+
+
+/*
+ * Description:
+ * Executes one step of the EEPROM job and fills the response frame when the job is done.
+ * Returns TRUE when the job is done.
+ */
+boolean performJobStep( EepromJob* job, LINK_FrameType* response )
+{
+	const LINK_FrameType* request = &job->request;
+	uint8 step = job->step++;
+
+	switch(request->command)
+	{
+	case CONTROL_COMPARE_TWO_PASSWORDS:
+		/* The passwords are compared in the first step and saved in the next steps if they are identical. */
+		if((step == 0) && (checkNewPassword(request->payload) == COMPARE_RESULT_FALSE))
+		{
+			break;
+		}
+		if(!savePasswordStep(request->payload, step))
+		{
+			g_eepromWriteTick = g_tickCount;
+			g_eepromWriting = TRUE;
+			return FALSE;
+		}
+		break;
+	case CONTROL_ERASE_SAVED_PASSWORD:
+		if(!eraseSavedPasswordStep(step))
+		{
+			g_eepromWriteTick = g_tickCount;
+			g_eepromWriting = TRUE;
+			return FALSE;
+		}
+		break;
+	case CONTROL_ADD_USER:
+		/* The users are changed only by the saved password, the user record is written in the first step. */
+		if(step == 0)
+		{
+			job->result = USER_SLOT_NONE;
+			if((checkPassword(request->payload) == COMPARE_RESULT_TRUE) &&
+					USER_startAdd(&request->payload[PASSWORD_LENGTH], &g_eepromTransaction, &job->result))
+			{
+				g_eepromWriteTick = g_tickCount;
+				g_eepromWriting = TRUE;
+				return FALSE;
+			}
+		}
+		break;
+	case CONTROL_REMOVE_USER:
+		if(step == 0)
+		{
+			job->result = USER_SLOT_NONE;
+			if((checkPassword(request->payload) == COMPARE_RESULT_TRUE) &&
+					USER_startRemove(request->payload[PASSWORD_LENGTH], &g_eepromTransaction))
+			{
+				job->result = request->payload[PASSWORD_LENGTH];
+				g_eepromWriteTick = g_tickCount;
+				g_eepromWriting = TRUE;
+				return FALSE;
+			}
+		}
+		break;
+	case CONTROL_READ_AUDIT_LOG:
+		/* One frame of entries is sent in each step, so the other requests are served during the read out. */
+		if(step == 0)
+		{
+			job->result = 0;
+		}
+		if((request->address != LINK_BROADCAST_ADDRESS) && sendAuditEntries(job))
+		{
+			return FALSE;
+		}
+		break;
+	default:
+		/* Read only requests are done in one step. */
+		performCommand(request, response);
+		return TRUE;
+	}
+
+	response->address = CONTROL_NODE_ADDRESS;
+	response->command = request->command | PROTOCOL_RESPONSE_FLAG;
+	response->sequence = request->sequence;
+	response->length = 1;
+	response->payload[0] = PROTOCOL_STATUS_OK;
+	if(request->command == CONTROL_COMPARE_TWO_PASSWORDS)
+	{
+		/* The new password is saved only if its record is committed. */
+		response->payload[response->length++] = ((step != 0) && (g_eepromTransaction.result == TWI_DONE)) ?
+				COMPARE_RESULT_TRUE : COMPARE_RESULT_FALSE;
+		if(response->payload[1] == COMPARE_RESULT_TRUE)
+		{
+			recordEvent(AUDIT_EVENT_PASSWORD_CHANGED, PROTOCOL_USER_SAVED_PASSWORD);
+		}
+	}
+	else if(request->command == CONTROL_ERASE_SAVED_PASSWORD)
+	{
+		if(g_eepromTransaction.result == TWI_DONE)
+		{
+			recordEvent(AUDIT_EVENT_PASSWORD_ERASED, PROTOCOL_USER_SAVED_PASSWORD);
+		}
+	}
+	else if((request->command == CONTROL_ADD_USER) || (request->command == CONTROL_REMOVE_USER))
+	{
+		/* The user is not changed if the write failed. */
+		response->payload[response->length++] = ((step == 0) || (g_eepromTransaction.result == TWI_DONE)) ?
+				job->result : USER_SLOT_NONE;
+		if(response->payload[1] != USER_SLOT_NONE)
+		{
+			recordEvent((request->command == CONTROL_ADD_USER) ? AUDIT_EVENT_USER_ADDED : AUDIT_EVENT_USER_REMOVED,
+					response->payload[1]);
+		}
+	}
+	else if(request->command == CONTROL_READ_AUDIT_LOG)
+	{
+		/* The payload holds the sequence after the last entry sent. */
+		response->payload[response->length++] = request->payload[0];
+		response->payload[response->length++] = request->payload[1];
+		response->payload[response->length++] = job->result;
+	}
+	return TRUE;
+}
+
+
+/*
+ * Description:
+ * Sends the next access log entries requested by CONTROL_READ_AUDIT_LOG in one CONTROL_AUDIT_ENTRIES frame.
+ * The position in the log is kept in the request payload and the number of entries sent in the job result.
+ * Returns FALSE if there is no entry left.
+ */
+boolean sendAuditEntries( EepromJob* job )
+{
+	LINK_FrameType frame;
+	uint16 sequence = ((uint16)job->request.payload[0] << 8) | job->request.payload[1];
+	uint8 count = AUDIT_read(&sequence, frame.payload, LINK_MAX_PAYLOAD_LENGTH / PROTOCOL_AUDIT_ENTRY_SIZE);
+
+	job->request.payload[0] = (uint8)(sequence >> 8);
+	job->request.payload[1] = (uint8)sequence;
+	if(count == 0)
+	{
+		return FALSE;
+	}
+	frame.address = CONTROL_NODE_ADDRESS;
+	frame.command = CONTROL_AUDIT_ENTRIES;
+	frame.sequence = job->request.sequence;
+	frame.length = count * PROTOCOL_AUDIT_ENTRY_SIZE;
+	LINK_sendFrame(&frame);
+	job->result += count;
+	return TRUE;
+}
+
+
+/*
+ * Description:
+ * Adds the event to the access log, it is written to EEPROM later between the EEPROM jobs.
+ */
+void recordEvent( uint8 event, uint8 user )
+{
+	AUDIT_record(event, user, getUptime());
+}
+
+
+/*
+ * Description:
+ * Returns the time in seconds since the boot.
+ */
+uint32 getUptime( void )
+{
+	/* The counter is 32 bits and updated by the timer ISR, so read it atomically. */
+	uint8 sreg = SREG;
+	uint32 time;
+
+	cli();
+	time = g_uptime;
+	SREG = sreg;
+	return time;
+}
+
+
+/*
+ * Description:
+ * Executes one request frame and sends its response frame to HMI MCU.
+ * Broadcast requests are executed by all control MCUs and never answered.
+ */
+void handleRequest( const LINK_FrameType* request )
+{
+	LINK_FrameType response;
+
+	performCommand(request, &response);
+	if(request->address != LINK_BROADCAST_ADDRESS)
+	{
+		sendResponse(&response);
+	}
+}
+
+
+/*
+ * Description:
+ * Queues the received request if it accesses EEPROM, otherwise executes it immediately.
  */
-void checkNewPassword( void );
+void dispatchRequest( const LINK_FrameType* request )
+{
+	if(handleRetransmission(request))
+	{
+		return;
+	}
+	/*
+	 * A request with a wrong length is answered immediately by PROTOCOL_STATUS_BAD_LENGTH.
+	 * The password checks are answered from the credentials cache, they are queued only behind
+	 * a pending EEPROM job to see the password it saves, or behind a flush of the access log as
+	 * the EEPROM can't be read during its write cycle.
+	 */
+	if(checkRequestLength(request) && (isEepromCommand(request->command) ||
+			(((g_eepromJobCount > 0) || g_eepromWriting) && isCredentialCommand(request->command))))
+	{
+		queueEepromJob(request);
+	}
+	else
+	{
+		handleRequest(request);
+	}
+}
+
+
 /*
  * Description:
- * This function translates the sent command to the corresponding funcition.
+ * Accepts the baud rate requested by CONTROL_SET_BAUD_RATE if it is valid at F_CPU.
+ * The rate is applied after sending the response.
  */
-void performCommand( uint8 command );
+uint8 requestBaudRate( const uint8* rate )
+{
+	uint32 bitRate = ((uint32)rate[0] << 24) | ((uint32)rate[1] << 16) | ((uint32)rate[2] << 8) | rate[3];
+
+	if(!UART_isBaudRateValid(bitRate))
+	{
+		return FALSE;
+	}
+	g_pendingBaudRate = bitRate;
+	return TRUE;
+}
+
+
 /*
  * Description:
- * Saves the password in EEPROM and change the status of saved password to LOGIC_HIGH.
+ * Switches UART to the accepted baud rate, the next frame received at the new rate confirms it.
  */
-void savePassword( uint8* password );
+void switchBaudRate( void )
+{
+	/* Let the response go out completely at the old rate, nothing is sent for a broadcast request. */
+	UART_flush();
+	UART_setBaudRate(g_pendingBaudRate);
+	/* Only a frame completed after the switch confirms the rate, the frames received before are dropped. */
+	LINK_resync();
+	g_baudRateSwitched = TRUE;
+	SWTIMER_start(g_baudTimer, PROTOCOL_BAUD_CONFIRM_TIMEOUT_MS, 0);
+}
+
+
 /*
  * Description:
- * Check the length of password and send result to HMI MCU.
+ * Handler of CONTROL_EVENT_BAUD_TIMEOUT, goes back to the old rate if the new one isn't confirmed.
  */
-void checkPasswordLength( void );
+void baudRateTimeout( void )
+{
+	if(!g_baudRateSwitched)
+	{
+		return;
+	}
+	UART_setBaudRate(g_baudRate);
+	LINK_resync();
+	g_baudRateSwitched = FALSE;
+	g_pendingBaudRate = 0;
+}
+
+
 /*
  * Description:
- * Checks the status of saved password flag and send the result to HMI MCU using UART.
+ * Compares the received password and re-entered password.
+ * Returns the result of comparison.
  */
-void checkSavedPassword( void );
+uint8 checkNewPassword( const uint8* passwords )
+{
+	/* The payload holds the password followed by the re-entered password. */
+	const uint8* password = passwords;
+	const uint8* reEnteredPassword = passwords + PASSWORD_LENGTH;
+
+	boolean result = COMPARE_RESULT_TRUE;
+	/* Comparing passwords*/
+	for (uint8 i = 0; i < PASSWORD_LENGTH; i++)
+	{
+		if(password[i] != reEnteredPassword[i])
+		{
+			result = COMPARE_RESULT_FALSE;
+			break;
+		}
+	}
+	return result;
+}
+
+
 /*
  * Description:
- * Erases the EEPROM password by erasing the flag that keeps status either there is a saved password or not.
+ * Check the length of password, returns TRUE if it is valid.
  */
-void eraseSavedPassword( void );
+uint8 checkPasswordLength( uint8 length )
+{
+	return (length == PASSWORD_LENGTH);
+}
+
+
 /*
  * Description:
- * This function is executed when the HMI controller sends CHECK_PASSWORD_WITH_SAVED_PASSWORD command.
- * It receives password using UART and compare it with saved password in EEPROM.
+ * Writes the password with the saved password flag set to LOGIC_HIGH in the first steps.
+ * Returns TRUE when the record is committed or its write failed.
  */
-void checkPassword( void );
+boolean savePasswordStep( const uint8* password, uint8 step )
+{
+	if(step == 0)
+	{
+		/* Flag followed by the password, they change together by the commit of the new record. */
+		g_credentials[0] = LOGIC_HIGH;
+		for (uint8 i = 0; i < PASSWORD_LENGTH; i++)
+		{
+			g_credentials[i + 1] = password[i];
+		}
+		g_credentialsCrc = calculateCredentialsCrc();
+	}
+	return saveCredentialsStep(step);
+}
+
+
 /*
  * Description:
- * Turns the motor clock wise.
+ * Writes the credentials cache as a new record in the first step and commits it in the second one.
+ * Returns TRUE when the record is committed or its write failed.
  */
-void openDoor( void );
+boolean saveCredentialsStep( uint8 step )
+{
+	switch(step)
+	{
+	case 0:
+		CREDENTIAL_startSave(g_credentials, &g_eepromTransaction);
+		return FALSE;
+	case 1:
+		/* The older record stays the valid one if the new record is not written. */
+		if(g_eepromTransaction.result != TWI_DONE)
+		{
+			return TRUE;
+		}
+		CREDENTIAL_startCommit(&g_eepromTransaction);
+		return FALSE;
+	default:
+		return TRUE;
+	}
+}
+
+
 /*
  * Description:
- * Turns the motor anti clock wise.
+ * Returns the status of saved password flag.
  */
-void closeDoor( void );
+uint8 checkSavedPassword( void )
+{
+	if(!validateCredentials())
+	{
+		return LOGIC_LOW;
+	}
+	return g_credentials[0];
+}
+
+
 /*
  * Description:
- * Stops the motor.
+ * Reads the saved password flag and the password from EEPROM to the credentials cache.
  */
-void stopDoor( void );
+void loadCredentials( void )
+{
+	g_credentialsLoaded = (CREDENTIAL_load(g_credentials) == SUCCESS);
+	g_credentialsCrc = calculateCredentialsCrc();
+}
 
 
-/***********************************************************************
- *                       Functions Implementation                      *
- ***********************************************************************/
-int main ( void )
+/*
+ * Description:
+ * Reloads the credentials cache if it is not loaded or its CRC doesn't match its data.
+ * Returns TRUE if the cache is valid.
+ */
+boolean validateCredentials( void )
 {
-	/* Enable global interrupt. */
-	SREG |= (1<<7);
-	/* Delay to let UART in the other MCU to be initialized */
-	EEPROM_init();
-	delay_ms(1);
-	UART_ConfigType config = {9600,BITS_8,NO_PARITY,ONE_STOP_BIT};
-	UART_init(&config);
-	DcMotor_Init();
-	BUZZER_Init();
-
-	/* Keep listening for HMI MCU requests. */
-	while(1)
+	if(!g_credentialsLoaded || (calculateCredentialsCrc() != g_credentialsCrc))
 	{
-		UART_sendByte(CONTROL_MCU_READY);
-		uint8 command = UART_recieveByte();
-		performCommand( command );
+		loadCredentials();
 	}
-
-	return 0;
+	return g_credentialsLoaded;
 }
 
 
 /*
  * Description:
- * This function translates the sent command to the corresponding funcition.
+ * Calculates CRC-8 (polynomial 0x07) of the credentials cache.
  */
-void performCommand( uint8 command )
+uint8 calculateCredentialsCrc( void )
 {
-	switch(command)
+	uint8 crc = 0xFF;
+	for (uint8 i = 0; i < CREDENTIAL_DATA_SIZE; i++)
 	{
-	case CONTROL_COMPARE_TWO_PASSWORDS:
-		checkNewPassword();
-		break;
-	case CONTROL_CHECK_PASSWORD_LENGTH:
-		checkPasswordLength();
-		break;
-	case CONTROL_CHECK_SAVED_PASSWORD_FLAG:
-		checkSavedPassword();
-		break;
-	case CONTROL_ERASE_SAVED_PASSWORD:
-		eraseSavedPassword();
-		break;
-	case CHECK_PASSWORD_WITH_SAVED_PASSWORD:
-		checkPassword();
-		break;
-	case CONTROL_MOTOR_ROTATE_CW:
-		openDoor();
-		break;
-	case CONTROL_MOTOR_STOP:
-		stopDoor();
-		break;
-	case CONTROL_MOTOR_ROTATE_CCW:
-		closeDoor();
-		break;
-	case CONTROL_BUZZER_ON:
-		BUZZER_On();
-		break;
-	case CONTROL_BUZZER_OFF:
-		BUZZER_Off();
-		break;
-	default:
-		break;
+		crc ^= g_credentials[i];
+		for (uint8 bit = 0; bit < 8; bit++)
+		{
+			crc = (crc & 0x80) ? (uint8)((crc << 1) ^ 0x07) : (uint8)(crc << 1);
+		}
 	}
+	return crc;
 }
 
 
 /*
  * Description:
- * Checks the validity of password and re-entered password and save password if valid.
+ * Erases the EEPROM password by erasing the flag that keeps status either there is a saved password or not.
+ * Returns TRUE when the record is committed or its write failed.
  */
-void checkNewPassword( void )
+boolean eraseSavedPasswordStep( uint8 step )
 {
-	uint8 password[PASSWORD_LENGTH];
-	uint8 reEnteredPassword[PASSWORD_LENGTH];
-
-	UART_sendByte(CONTROL_MCU_READY);
-
-	/* Receiving password */
-	for (uint8 i = 0; i < PASSWORD_LENGTH; i++)
+	if(step == 0)
 	{
-		password[i] = UART_recieveByte();
+		g_credentials[0] = LOGIC_LOW;
+		g_credentialsCrc = calculateCredentialsCrc();
 	}
-	/* Receiving reentered password */
-	for (uint8 i = 0; i < PASSWORD_LENGTH; i++)
+	return saveCredentialsStep(step);
+}
+
+
+/*
+ * Description:
+ * This function is executed when the HMI controller sends CHECK_PASSWORD_WITH_SAVED_PASSWORD command.
+ * It compares the received password with saved password in the credentials cache and returns the result,
+ * which is always COMPARE_RESULT_FALSE if there is no saved password.
+ */
+uint8 checkPassword( const uint8* enteredPassword )
+{
+	/* Getting saved password from the cache, it follows the flag, an erased password matches nothing */
+	if(!validateCredentials() || (g_credentials[0] != LOGIC_HIGH))
 	{
-		reEnteredPassword[i] = UART_recieveByte();
+		return COMPARE_RESULT_FALSE;
 	}
-
+	const uint8* savedPassword = &g_credentials[1];
 	boolean result = COMPARE_RESULT_TRUE;
 	/* Comparing passwords*/
 	for (uint8 i = 0; i < PASSWORD_LENGTH; i++)
 	{
-		if(password[i] != reEnteredPassword[i])
+		if(enteredPassword[i] != savedPassword[i])
 		{
 			result = COMPARE_RESULT_FALSE;
 			break;
 		}
 	}
-	/* If result and re-enterred passwords are identical, save password to EEPROM. */
-	if(result == COMPARE_RESULT_TRUE)
+	return result;
+}
+
+
+/*
+ * Description:
+ * Turns the motor clock wise.
+ */
+void openDoor( void )
+{
+	DcMotor_Rotate(CW);
+}
+
+
+/*
+ * Description:
+ * Turns the motor anti clock wise.
+ */
+void closeDoor( void )
+{
+	DcMotor_Rotate(A_CW);
+}
+
+
+/*
+ * Description:
+ * Stops the motor.
+ */
+void stopDoor( void )
+{
+	DcMotor_Rotate(STOP);
+}
+
+
+/*
+ * Description:
+ * Starts the open/hold/close door cycle, the cycle is continued by the door timer.
+ */
+void startDoorCycle( uint8 sequence )
+{
+	g_doorCycleSequence = sequence;
+	g_doorState = DOOR_STATE_OPENING;
+	openDoor();
+	SWTIMER_start(g_doorTimer, DOOR_OPENING_TIME_MS, 0);
+	SCHEDULER_post(CONTROL_EVENT_DOOR);
+}
+
+
+/*
+ * Description:
+ * Called by the system tick each 1 ms, counts the time, runs the link and TWI timeouts
+ * and runs the EEPROM jobs again while they wait for the EEPROM.
+ */
+void controlTick( void )
+{
+	g_tickCount++;
+	if(++g_uptimeMs == 1000)
+	{
+		g_uptimeMs = 0;
+		g_uptime++;
+	}
+	LINK_timerTick();
+	TWI_timerTick();
+	if((g_eepromJobCount > 0) || g_eepromWriting)
 	{
-		savePassword( password );
+		SCHEDULER_post(CONTROL_EVENT_EEPROM);
 	}
-	while(UART_recieveByte() != HMI_MCU_READY);
-	UART_sendByte(result);
 }
 
 
 /*
  * Description:
- * Check the length of password and send result to HMI MCU.
+ * Idle handler of the scheduler, sleeps until the next event, the tick isn't stretched while
+ * the EEPROM jobs wait for the EEPROM.
  */
-void checkPasswordLength( void )
+void enterIdle( void )
 {
-	/* Get length of the entered password. */
-	UART_sendByte(CONTROL_MCU_READY);
-	uint8 length = UART_recieveByte();
-	/* Send the result of comparison to HMI MCU to represent an error. */
-	while(UART_recieveByte() != HMI_MCU_READY);
-	UART_sendByte(length == PASSWORD_LENGTH);
+	if((g_eepromJobCount > 0) || g_eepromWriting)
+	{
+		POWER_idle(1);
+	}
+	else
+	{
+		POWER_idle(TIMER_MAX_SYSTEM_TICK_MS);
+	}
 }
 
 
 /*
  * Description:
- * Saves the password in EEPROM and change the status of saved password to LOGIC_HIGH.
+ * Callback of the door timer, moves the door cycle to the next state when the current one ends
+ * and posts CONTROL_EVENT_DOOR to report it.
  */
-void savePassword( uint8* const password )
+void doorTimerExpired( void )
 {
-	for(uint8 i = 0; i < PASSWORD_LENGTH; i++)
+	switch(g_doorState)
 	{
-		EEPROM_writeByte(PASSWORD_START_ADDRESS + i, password[i]);
-		delay_ms(10);
+	case DOOR_STATE_OPENING:
+		stopDoor();
+		g_doorState = DOOR_STATE_HOLDING;
+		SWTIMER_start(g_doorTimer, DOOR_HOLDING_TIME_MS, 0);
+		break;
+	case DOOR_STATE_HOLDING:
+		closeDoor();
+		g_doorState = DOOR_STATE_CLOSING;
+		SWTIMER_start(g_doorTimer, DOOR_CLOSING_TIME_MS, 0);
+		break;
+	case DOOR_STATE_CLOSING:
+		stopDoor();
+		g_doorState = DOOR_STATE_CLOSED;
+		break;
 	}
-	EEPROM_writeByte(SAVED_PASSWORD_FLAG_ADDRESS, LOGIC_HIGH);
-	delay_ms(10);
+	SCHEDULER_post(CONTROL_EVENT_DOOR);
 }
 
 
 /*
  * Description:
- * Checks the status of saved password flag and send the result to HMI MCU using UART.
+ * Handler of CONTROL_EVENT_DOOR, sends CONTROL_DOOR_EVENT frame to HMI MCU if the door state
+ * changed since the last report.
  */
-void checkSavedPassword( void )
+void reportDoorState( void )
 {
-	uint8 flag;
-	EEPROM_readByte(SAVED_PASSWORD_FLAG_ADDRESS, &flag);
-	while(UART_recieveByte() != HMI_MCU_READY);
-	UART_sendByte(flag);
+	uint8 state = g_doorState;
+	if(state == g_reportedDoorState)
+	{
+		return;
+	}
+	LINK_FrameType event;
+	event.address = CONTROL_NODE_ADDRESS;
+	event.command = CONTROL_DOOR_EVENT;
+	event.sequence = g_doorCycleSequence;
+	event.length = 1;
+	event.payload[0] = state;
+	LINK_sendFrame(&event);
+	g_reportedDoorState = state;
 }
 
 
 /*
  * Description:
- * Erases the EEPROM password by erasing the flag that keeps status either there is a saved password or not.
+ * Goes back to the boot baud rate when HMI MCU is silent for LINK_PEER_TIMEOUT_MS,
+ * so a restarted HMI MCU can reach this controller again.
  */
-void eraseSavedPassword( void )
+void checkLinkState( void )
 {
-	EEPROM_writeByte(SAVED_PASSWORD_FLAG_ADDRESS, LOGIC_LOW);
-	delay_ms(10);
+	LINK_StateType state = LINK_getState();
+	if(state == g_linkState)
+	{
+		return;
+	}
+	g_linkState = state;
+	if(state == LINK_UP)
+	{
+		return;
+	}
+	g_pendingBaudRate = 0;
+	/* A new HMI MCU session restarts the sequence numbers, so forget the saved responses. */
+	for(uint8 i = 0; i < RESPONSE_CACHE_SIZE; i++)
+	{
+		g_responseCache[i].command = 0;
+	}
+	if(g_baudRate != PROTOCOL_BOOT_BAUD_RATE)
+	{
+		UART_flush();
+		UART_setBaudRate(PROTOCOL_BOOT_BAUD_RATE);
+		g_baudRate = PROTOCOL_BOOT_BAUD_RATE;
+	}
+	LINK_resync();
 }
 
 
 /*
  * Description:
- * This function is executed when the HMI controller sends CHECK_PASSWORD_WITH_SAVED_PASSWORD command.
- * It receives password using UART and compare it with saved password in EEPROM.
+ * Sends the response to HMI MCU and keeps it to answer a retransmission of the same request.
  */
-void checkPassword( void )
+void sendResponse( const LINK_FrameType* response )
 {
-	uint8 savedPassword[PASSWORD_LENGTH];
-	uint8 enteredPassword[PASSWORD_LENGTH];
-	UART_sendByte(CONTROL_MCU_READY);
-	/* Receiving password */
-	for (uint8 i = 0; i < PASSWORD_LENGTH; i++)
+	g_responseCache[g_responseCacheNext] = *response;
+	g_responseTime[g_responseCacheNext] = LINK_getTime();
+	g_responseCacheNext = (g_responseCacheNext + 1) % RESPONSE_CACHE_SIZE;
+	LINK_sendFrame(response);
+}
+
+
+/*
+ * Description:
+ * Answers a retransmitted request by its saved response, or by CONTROL_ACK if it is still queued.
+ * Returns TRUE if the request is a retransmission.
+ */
+boolean handleRetransmission( const LINK_FrameType* request )
+{
+	uint16 now = LINK_getTime();
+
+	/* Broadcast requests have no response, so they are never retransmitted. */
+	if(request->address == LINK_BROADCAST_ADDRESS)
 	{
-		enteredPassword[i] = UART_recieveByte();
+		return FALSE;
 	}
-	/* Getting saved password from EEPROM */
-	for (uint8 i = 0; i < PASSWORD_LENGTH; i++)
+	for(uint8 i = 0; i < RESPONSE_CACHE_SIZE; i++)
 	{
-		EEPROM_readByte(PASSWORD_START_ADDRESS + i, savedPassword + i);
+		/* The same sequence out of the retry window is a new request after the sequence wrapped. */
+		if((g_responseCache[i].command == (request->command | PROTOCOL_RESPONSE_FLAG)) &&
+				(g_responseCache[i].sequence == request->sequence) &&
+				((uint16)(now - g_responseTime[i]) < PROTOCOL_RETRY_WINDOW_MS))
+		{
+			LINK_sendFrame(&g_responseCache[i]);
+			return TRUE;
+		}
 	}
-	boolean result = COMPARE_RESULT_TRUE;
-	/* Comparing passwords*/
-	for (uint8 i = 0; i < PASSWORD_LENGTH; i++)
+	for(uint8 i = 0; i < g_eepromJobCount; i++)
 	{
-		if(enteredPassword[i] != savedPassword[i])
+		const LINK_FrameType* queued = &g_eepromJobs[(g_eepromJobHead + i) % EEPROM_JOB_QUEUE_SIZE].request;
+		if((queued->command == request->command) && (queued->sequence == request->sequence))
 		{
-			result = COMPARE_RESULT_FALSE;
-			break;
+			/* The first CONTROL_ACK was lost. */
+			sendAck(request);
+			return TRUE;
 		}
 	}
-	while(UART_recieveByte() != HMI_MCU_READY);
-	UART_sendByte(result);
+	return FALSE;
 }
 
 
 /*
  * Description:
- * Turns the motor clock wise.
+ * Sends CONTROL_ACK for the request queued in the EEPROM jobs queue.
  */
-void openDoor( void )
+void sendAck( const LINK_FrameType* request )
 {
-	DcMotor_Rotate(CW);
+	LINK_FrameType ack;
+	ack.address = CONTROL_NODE_ADDRESS;
+	ack.command = CONTROL_ACK;
+	ack.sequence = request->sequence;
+	ack.length = 1;
+	ack.payload[0] = request->command;
+	LINK_sendFrame(&ack);
 }
 
 
 /*
  * Description:
- * Turns the motor anti clock wise.
+ * Sends CONTROL_NACK if the link dropped a frame since the last check,
+ * so HMI MCU retransmits its pending requests without waiting for the timeout.
  */
-void closeDoor( void )
+void checkLinkErrors( void )
 {
-	DcMotor_Rotate(A_CW);
+	uint16 errorCount = LINK_getErrorCount();
+	if(errorCount == g_linkErrorCount)
+	{
+		return;
+	}
+	g_linkErrorCount = errorCount;
+	LINK_FrameType nack;
+	nack.address = CONTROL_NODE_ADDRESS;
+	nack.command = CONTROL_NACK;
+	nack.sequence = 0;
+	nack.length = 0;
+	LINK_sendFrame(&nack);
 }
 
 
+#ifdef CONTROL_EEPROM_BENCHMARK
 /*
  * Description:
- * Stops the motor.
+ * Reads the saved password of the loaded credential record BENCHMARK_RUNS times byte by byte
+ * then by one block read, and saves the TWI bytes and the time in us taken by each method.
  */
-void stopDoor( void )
+void benchmarkPasswordRead( void )
 {
-	DcMotor_Rotate(STOP);
-}
+	uint8 savedPassword[PASSWORD_LENGTH];
+	/* The password follows the saved password flag in the newest credential record. */
+	uint16 address = CREDENTIAL_getDataAddress() + 1;
+	uint32 startTime;
 
+	TWI_resetTransferCount();
+	startTime = TIMER_micros();
+	for (uint8 run = 0; run < BENCHMARK_RUNS; run++)
+	{
+		for (uint8 i = 0; i < PASSWORD_LENGTH; i++)
+		{
+			EEPROM_readByte(address + i, savedPassword + i);
+		}
+	}
+	g_benchmarkTimeUs[0] = TIMER_micros() - startTime;
+	g_benchmarkTransfers[0] = TWI_getTransferCount();
+
+	TWI_resetTransferCount();
+	startTime = TIMER_micros();
+	for (uint8 run = 0; run < BENCHMARK_RUNS; run++)
+	{
+		EEPROM_readBlock(address, savedPassword, PASSWORD_LENGTH);
+	}
+	g_benchmarkTimeUs[1] = TIMER_micros() - startTime;
+	g_benchmarkTransfers[1] = TWI_getTransferCount();
+}
+#endif
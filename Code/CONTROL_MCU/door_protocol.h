@@ -0,0 +1,183 @@
+/*
+ *
+ * Module: Door locking protocol.
+ *
+ * File Name: door_protocol.h
+ *
+ * Description: Commands and responses exchanged between HMI MCU and control MCU
+ *              over the link frames. This file must be identical in both projects.
+ *
+ * Author: Mohamed Khaled.
+ *
+ */
+
+#ifndef DOOR_PROTOCOL_H_
+#define DOOR_PROTOCOL_H_
+
+/***********************************************************************
+ *                             Definitions                              *
+ ***********************************************************************/
+/* Commands that can be handled by control MCU, sent in the command field of the request frame. */
+#define CONTROL_COMPARE_TWO_PASSWORDS					 0x01
+#define CONTROL_CHECK_PASSWORD_LENGTH  					 0x02
+#define CONTROL_CHECK_SAVED_PASSWORD_FLAG 				 0x03
+#define CONTROL_ERASE_SAVED_PASSWORD					 0x04
+#define CHECK_PASSWORD_WITH_SAVED_PASSWORD				 0x05
+#define CONTROL_MOTOR_ROTATE_CW							 0x06
+#define CONTROL_MOTOR_STOP 								 0x07
+#define CONTROL_MOTOR_ROTATE_CCW						 0x08
+#define CONTROL_BUZZER_ON 								 0X09
+#define CONTROL_BUZZER_OFF								 0X0A
+/*
+ * Verifies the password in the payload and if it is correct, the control MCU runs the whole
+ * open/hold/close profile by itself and reports its progress by CONTROL_DOOR_EVENT frames.
+ */
+#define CONTROL_VERIFY_AND_CYCLE_DOOR					 0x0B
+
+/*
+ * Requests a new baud rate, payload: [rate bits 31..24, 23..16, 15..8, 7..0].
+ * The response is sent at the current rate, then both MCUs switch and the HMI MCU confirms the
+ * new rate by CONTROL_PING within PROTOCOL_BAUD_CONFIRM_TIMEOUT_MS, otherwise both go back.
+ */
+#define CONTROL_SET_BAUD_RATE							 0x0C
+/* Empty request answered by an empty response, used to check the link. */
+#define CONTROL_PING									 0x0D
+/*
+ * Exchanged at boot, payload: [protocol version of HMI MCU].
+ * Response payload: [status, protocol version, capabilities of control MCU].
+ * Older control firmware answers by PROTOCOL_STATUS_UNKNOWN_COMMAND, then no capability is assumed.
+ */
+#define CONTROL_HELLO									 0x0E
+/*
+ * Users of the door, each one opens it by its own password by CONTROL_VERIFY_AND_CYCLE_DOOR.
+ * CONTROL_ADD_USER payload: [saved password, user password], response payload: [status, user slot].
+ * CONTROL_REMOVE_USER payload: [saved password, user slot], response payload: [status, user slot].
+ * CONTROL_VERIFY_USER payload: [user password], response payload: [status, user slot].
+ * The user slot is PROTOCOL_USER_NONE if the user is not found or not added or removed.
+ */
+#define CONTROL_ADD_USER								 0x0F
+#define CONTROL_REMOVE_USER								 0x10
+#define CONTROL_VERIFY_USER								 0x11
+#define PROTOCOL_USER_NONE								 0xFF
+/*
+ * Wear of the EEPROM pages that hold the saved password, each change writes the next page in turn.
+ * Payload: [first page], response payload: [status, first page, write cycles of each page from the first
+ * one (16 bits, MSB first)]. The response holds as many pages as fit in the frame, the next request
+ * starts from the page after them. No count is returned past the last page.
+ */
+#define CONTROL_GET_WEAR_STATS							 0x12
+/*
+ * Reads the access log, payload: [first sequence MSB, LSB]. The entries from this sequence, or from the
+ * oldest kept one, are streamed by CONTROL_AUDIT_ENTRIES frames, then the response payload is
+ * [status, sequence after the last entry sent MSB, LSB, number of entries sent].
+ */
+#define CONTROL_READ_AUDIT_LOG							 0x13
+/*
+ * Time control MCU spent asleep since its boot, no payload,
+ * response payload: [status, asleep time in 1/1000 of the total time MSB, LSB].
+ */
+#define CONTROL_GET_POWER_STATS							 0x14
+
+/*
+ * Frame sent by control MCU without a request each time the door state changes.
+ * It carries the sequence of the request that started the cycle and payload: [door state].
+ */
+#define CONTROL_DOOR_EVENT								 0x40
+/*
+ * Sent by control MCU as soon as a slow request is queued, with the request sequence and
+ * payload: [request command]. The HMI MCU stops retransmitting it and waits for the response.
+ */
+#define CONTROL_ACK										 0x41
+/*
+ * Sent by control MCU after it drops a corrupted frame, the HMI MCU retransmits its requests
+ * that are not answered or acknowledged yet.
+ */
+#define CONTROL_NACK									 0x42
+/* Part of the CONTROL_READ_AUDIT_LOG stream with the request sequence, payload: [entries]. */
+#define CONTROL_AUDIT_ENTRIES							 0x43
+
+/*
+ * Entry of the access log: [sequence MSB, LSB, event, user slot, time in seconds since the boot of
+ * control MCU (24 bits, MSB first), CRC-8 (polynomial 0x07) of the previous bytes].
+ */
+#define PROTOCOL_AUDIT_ENTRY_SIZE						 8
+#define AUDIT_EVENT_BOOT								 0x00
+#define AUDIT_EVENT_UNLOCK								 0x01
+#define AUDIT_EVENT_PASSWORD_ACCEPTED					 0x02
+#define AUDIT_EVENT_PASSWORD_REJECTED					 0x03
+/* The buzzer is started after the third wrong password. */
+#define AUDIT_EVENT_LOCKOUT								 0x04
+#define AUDIT_EVENT_PASSWORD_CHANGED					 0x05
+#define AUDIT_EVENT_PASSWORD_ERASED						 0x06
+#define AUDIT_EVENT_USER_ADDED							 0x07
+#define AUDIT_EVENT_USER_REMOVED						 0x08
+/* Entries were dropped while the log buffer was full, the user slot holds their number (up to 255). */
+#define AUDIT_EVENT_OVERFLOW							 0x09
+/* User slot of the events done by the saved password, PROTOCOL_USER_NONE if the user is unknown. */
+#define PROTOCOL_USER_SAVED_PASSWORD					 0xFE
+
+/* Door states reported in CONTROL_DOOR_EVENT frames. */
+#define DOOR_STATE_CLOSED								 0x00
+#define DOOR_STATE_OPENING								 0x01
+#define DOOR_STATE_HOLDING								 0x02
+#define DOOR_STATE_CLOSING								 0x03
+
+/*
+ * The response frame carries the request command with this flag set and the same sequence number.
+ * Payload of the response: [status, result...].
+ */
+#define PROTOCOL_RESPONSE_FLAG							 0x80
+
+/*
+ * Maximum number of requests sent by HMI MCU to one control MCU before receiving their responses.
+ * Responses may come out of order, the slow EEPROM requests are answered after the fast ones.
+ */
+#define PROTOCOL_MAX_OUTSTANDING_REQUESTS				 4
+
+/*
+ * A request is retransmitted with the same sequence only within this time, so control MCU
+ * answers a repeated sequence by its saved response instead of executing the request again.
+ */
+#define PROTOCOL_RETRY_WINDOW_MS						 500
+
+/* Status of the request, first byte of every response payload. */
+#define PROTOCOL_STATUS_OK								 0x00
+#define PROTOCOL_STATUS_UNKNOWN_COMMAND					 0x01
+#define PROTOCOL_STATUS_BAD_LENGTH						 0x02
+#define PROTOCOL_STATUS_BUSY							 0x03
+/* Set by HMI MCU itself when no response is received before the request deadline, never sent. */
+#define PROTOCOL_STATUS_TIMEOUT							 0x04
+
+/* Version of this command table, increased each time a command is added or changed. */
+#define PROTOCOL_VERSION								 0x06
+
+/* Capabilities of control MCU, bits of the CONTROL_HELLO response. */
+/* HMI MCU may check the password length by itself without CONTROL_CHECK_PASSWORD_LENGTH. */
+#define PROTOCOL_CAP_LOCAL_LENGTH_CHECK					 0x01
+/* CONTROL_VERIFY_AND_CYCLE_DOOR is supported, otherwise HMI MCU drives the motor commands. */
+#define PROTOCOL_CAP_VERIFY_AND_CYCLE					 0x02
+/* Passwords are saved and read from the EEPROM as one block instead of byte by byte. */
+#define PROTOCOL_CAP_BLOCK_EEPROM						 0x04
+/* CONTROL_ADD_USER, CONTROL_REMOVE_USER and CONTROL_VERIFY_USER are supported. */
+#define PROTOCOL_CAP_MULTI_USER							 0x08
+/* CONTROL_GET_WEAR_STATS is supported. */
+#define PROTOCOL_CAP_WEAR_STATS							 0x10
+/* CONTROL_READ_AUDIT_LOG is supported. */
+#define PROTOCOL_CAP_AUDIT_LOG							 0x20
+/* CONTROL_GET_POWER_STATS is supported. */
+#define PROTOCOL_CAP_POWER_STATS						 0x40
+
+/* Door profile, run by control MCU or by HMI MCU when PROTOCOL_CAP_VERIFY_AND_CYCLE is missing. */
+#define DOOR_OPENING_TIME_MS							 1000
+#define DOOR_HOLDING_TIME_MS							 500
+#define DOOR_CLOSING_TIME_MS							 1000
+
+/* Every MCU starts at this baud rate after reset. */
+#define PROTOCOL_BOOT_BAUD_RATE							 9600UL
+#define PROTOCOL_BAUD_CONFIRM_TIMEOUT_MS				 50
+
+#define COMPARE_RESULT_TRUE 0x01
+#define COMPARE_RESULT_FALSE 0x00
+#define PASSWORD_LENGTH								   	5
+
+#endif /* DOOR_PROTOCOL_H_ */
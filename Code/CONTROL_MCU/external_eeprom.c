@@ -11,7 +11,9 @@
  *******************************************************************************/
 #include "external_eeprom.h"
 #include "twi.h"
-#include "delay.h"
+
+/* Device address with R/W=0 (write), we need to get A8 A9 A10 address bits from the memory location address. */
+#define EEPROM_DEVICE_ADDRESS(u16addr) ((uint8)(0xA0 | (((u16addr) & 0x0700)>>7)))
 
 
 void EEPROM_init()
@@ -23,70 +25,122 @@ void EEPROM_init()
 
 uint8 EEPROM_writeByte(uint16 u16addr, uint8 u8data)
 {
-	/* Send the Start Bit */
-    TWI_start();
-    if (TWI_getStatus() != TWI_START)
-        return ERROR;
-		
-    /* Send the device address, we need to get A8 A9 A10 address bits from the
-     * memory location address and R/W=0 (write) */
-    TWI_writeByte((uint8)(0xA0 | ((u16addr & 0x0700)>>7)));
-    if (TWI_getStatus() != TWI_MT_SLA_W_ACK)
-        return ERROR; 
-		 
-    /* Send the required memory location address */
-    TWI_writeByte((uint8)(u16addr));
-    if (TWI_getStatus() != TWI_MT_DATA_ACK)
-        return ERROR;
-		
-    /* write byte to eeprom */
-    TWI_writeByte(u8data);
-    if (TWI_getStatus() != TWI_MT_DATA_ACK)
-        return ERROR;
-
-    /* Send the Stop Bit */
-    TWI_stop();
-	
-    return SUCCESS;
+	return EEPROM_writeBlock(u16addr, &u8data, 1);
 }
 
 
 uint8 EEPROM_readByte(uint16 u16addr, uint8 *u8data)
 {
-	/* Send the Start Bit */
-    TWI_start();
-    if (TWI_getStatus() != TWI_START)
-        return ERROR;
-		
-    /* Send the device address, we need to get A8 A9 A10 address bits from the
-     * memory location address and R/W=0 (write) */
-    TWI_writeByte((uint8)((0xA0) | ((u16addr & 0x0700)>>7)));
-    if (TWI_getStatus() != TWI_MT_SLA_W_ACK)
-        return ERROR;
-		
-    /* Send the required memory location address */
-    TWI_writeByte((uint8)(u16addr));
-    if (TWI_getStatus() != TWI_MT_DATA_ACK)
-        return ERROR;
-		
-    /* Send the Repeated Start Bit */
-    TWI_start();
-    if (TWI_getStatus() != TWI_REP_START)
-        return ERROR;
-		
-    /* Send the device address, we need to get A8 A9 A10 address bits from the
-     * memory location address and R/W=1 (Read) */
-    TWI_writeByte((uint8)((0xA0) | ((u16addr & 0x0700)>>7) | 1));
-    if (TWI_getStatus() != TWI_MT_SLA_R_ACK)
-        return ERROR;
-
-    /* Read Byte from Memory without send ACK */
-    *u8data = TWI_readByteWithNACK();
-    if (TWI_getStatus() != TWI_MR_DATA_NACK)
-        return ERROR;
-
-    /* Send the Stop Bit */
-    TWI_stop();
-
-    return SUCCESS;
+	return EEPROM_readBlock(u16addr, u8data, 1);
+}
+
+
+uint8 EEPROM_writeBlock(uint16 u16addr, const uint8 *u8data, uint8 u8length)
+{
+	TWI_Transaction transaction;
+	uint8 count;
+
+	while(u8length > 0)
+	{
+		/* Bytes left till the end of the current page, the address wraps inside the page after it. */
+		count = EEPROM_PAGE_SIZE - (u16addr & (EEPROM_PAGE_SIZE - 1));
+		if(count > u8length)
+		{
+			count = u8length;
+		}
+		EEPROM_startWrite(&transaction, u16addr, u8data, count);
+		if(TWI_wait(&transaction) != TWI_DONE)
+		{
+			return ERROR;
+		}
+		u16addr += count;
+		u8data += count;
+		u8length -= count;
+		/* Wait for the write cycle of this page before addressing the next one. */
+		if((u8length > 0) && (EEPROM_waitReady() == ERROR))
+		{
+			return ERROR;
+		}
+	}
+	return SUCCESS;
+}
+
+
+uint8 EEPROM_readBlock(uint16 u16addr, uint8 *u8data, uint8 u8length)
+{
+	TWI_Transaction transaction;
+
+	if(u8length == 0)
+	{
+		return SUCCESS;
+	}
+	EEPROM_startRead(&transaction, u16addr, u8data, u8length);
+	return (TWI_wait(&transaction) == TWI_DONE) ? SUCCESS : ERROR;
+}
+
+
+void EEPROM_startWrite(TWI_Transaction* transaction, uint16 u16addr, const uint8 *u8data, uint8 u8length)
+{
+	/* The memory location address is sent first, then the EEPROM increments it after each byte. */
+	transaction->type = TWI_WRITE;
+	transaction->slaveAddress = EEPROM_DEVICE_ADDRESS(u16addr);
+	transaction->useSubAddress = TRUE;
+	transaction->subAddress = (uint8)u16addr;
+	transaction->writeData = u8data;
+	transaction->writeLength = u8length;
+	transaction->readData = NULL_PTR;
+	transaction->readLength = 0;
+	transaction->timeout = EEPROM_TRANSACTION_TIMEOUT_MS;
+	transaction->callBack = NULL_PTR;
+	TWI_submit(transaction);
+}
+
+
+void EEPROM_startRead(TWI_Transaction* transaction, uint16 u16addr, uint8 *u8data, uint8 u8length)
+{
+	/*
+	 * The memory location address is written, then the bytes are read sequentially after a repeated
+	 * start, every byte is acknowledged except the last one.
+	 */
+	transaction->type = TWI_WRITE_READ;
+	transaction->slaveAddress = EEPROM_DEVICE_ADDRESS(u16addr);
+	transaction->useSubAddress = TRUE;
+	transaction->subAddress = (uint8)u16addr;
+	transaction->writeData = NULL_PTR;
+	transaction->writeLength = 0;
+	transaction->readData = u8data;
+	transaction->readLength = u8length;
+	transaction->timeout = EEPROM_TRANSACTION_TIMEOUT_MS;
+	transaction->callBack = NULL_PTR;
+	TWI_submit(transaction);
+}
+
+
+boolean EEPROM_isBusy(void)
+{
+	TWI_Transaction transaction;
+
+	/* Only the acknowledge of the device address is checked, the memory location doesn't matter. */
+	transaction.type = TWI_WRITE;
+	transaction.slaveAddress = EEPROM_DEVICE_ADDRESS(0);
+	transaction.useSubAddress = FALSE;
+	transaction.writeData = NULL_PTR;
+	transaction.writeLength = 0;
+	transaction.timeout = EEPROM_TRANSACTION_TIMEOUT_MS;
+	transaction.callBack = NULL_PTR;
+	TWI_submit(&transaction);
+	return (TWI_wait(&transaction) != TWI_DONE);
+}
+
+
+uint8 EEPROM_waitReady(void)
+{
+	for (uint16 i = 0; i < EEPROM_READY_POLL_LIMIT; i++)
+	{
+		if(!EEPROM_isBusy())
+		{
+			return SUCCESS;
+		}
+	}
+	return ERROR;
 }
@@ -15,6 +15,7 @@
 #define EXTERNAL_EEPROM_H_
 
 #include "std_types.h"
+#include "twi.h"
 
 /*******************************************************************************
  *                      Preprocessor Macros                                    *
@@ -22,6 +23,18 @@
 #define ERROR 0
 #define SUCCESS 1
 
+/* 24C16: bytes written by one page write, a page write never crosses the page boundary. */
+#define EEPROM_PAGE_SIZE 16
+/* Maximum time of the internal write cycle, the EEPROM doesn't answer during it. */
+#define EEPROM_WRITE_CYCLE_MS 10
+/*
+ * Address polls done by EEPROM_waitReady before giving up, one poll takes about 30us at 400KHz,
+ * so the limit covers more than EEPROM_WRITE_CYCLE_MS.
+ */
+#define EEPROM_READY_POLL_LIMIT 1000
+/* Time given to one TWI transaction, a full page write takes less than 1ms at 400KHz. */
+#define EEPROM_TRANSACTION_TIMEOUT_MS 5
+
 /*******************************************************************************
  *                      Functions Prototypes                                   *
  *******************************************************************************/
@@ -29,5 +42,36 @@
 void EEPROM_init();
 uint8 EEPROM_writeByte(uint16 u16addr,uint8 u8data);
 uint8 EEPROM_readByte(uint16 u16addr,uint8 *u8data);
+/*
+ * Writes u8length bytes starting at u16addr, one page write for each EEPROM page the block covers.
+ * Waits for the write cycle between the pages, but not after the last one.
+ */
+uint8 EEPROM_writeBlock(uint16 u16addr, const uint8 *u8data, uint8 u8length);
+/*
+ * Returns TRUE while the EEPROM is in its write cycle, it doesn't acknowledge its address till
+ * the cycle is finished.
+ */
+boolean EEPROM_isBusy(void);
+/*
+ * Reads u8length bytes starting at u16addr by one sequential read, every byte is acknowledged
+ * except the last one. The address wraps around at the end of the memory.
+ */
+uint8 EEPROM_readBlock(uint16 u16addr, uint8 *u8data, uint8 u8length);
+/*
+ * Polls the EEPROM till its write cycle is finished.
+ * Returns ERROR if it is still busy after EEPROM_READY_POLL_LIMIT polls.
+ */
+uint8 EEPROM_waitReady(void);
+/*
+ * Starts writing u8length bytes at u16addr by transaction and returns without waiting,
+ * the block must not cross an EEPROM page. The transaction and the data must stay valid
+ * till the transaction result is not TWI_PENDING, then the write cycle of the EEPROM starts.
+ */
+void EEPROM_startWrite(TWI_Transaction* transaction, uint16 u16addr, const uint8 *u8data, uint8 u8length);
+/*
+ * Starts reading u8length bytes at u16addr by transaction and returns without waiting.
+ * The transaction and the buffer must stay valid till the transaction result is not TWI_PENDING.
+ */
+void EEPROM_startRead(TWI_Transaction* transaction, uint16 u16addr, uint8 *u8data, uint8 u8length);
  
 #endif /* EXTERNAL_EEPROM_H_ */
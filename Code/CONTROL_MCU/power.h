@@ -0,0 +1,56 @@
+ /******************************************************************************
+ *
+ * Module: POWER
+ *
+ * File Name: power.h
+ *
+ * Description: Header file for the idle mode, the CPU sleeps between the events and the
+ *              system tick is stopped until the next software timer expiry.
+ *
+ * Author: Mohamed Khaled.
+ *
+ *******************************************************************************/
+
+#ifndef POWER_H_
+#define POWER_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/*
+ * The system tick is stretched only if no software timer expires in the next POWER_TICKLESS_MIN_MS ms,
+ * otherwise the CPU sleeps until the next 1 ms tick or any other interrupt.
+ */
+#ifndef POWER_TICKLESS_MIN_MS
+#define POWER_TICKLESS_MIN_MS             2
+#endif
+
+/*******************************************************************************
+ *                      Functions Prototypes                                   *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Selects the idle sleep mode and clears the sleep statistics, the system tick must be started.
+ * The power-save mode is not used as it stops timer 1, only timer 2 runs on its external crystal.
+ */
+void POWER_init(void);
+
+/*
+ * Description :
+ * Sleeps until an interrupt, the system tick is stretched up to maxSleepMs or to the next software timer.
+ * It is called as the idle handler of the scheduler with the interrupts disabled, the wake up interrupts
+ * are the UART, the system tick and the other peripherals. The ms passed are counted before it returns.
+ */
+void POWER_idle(uint8 maxSleepMs);
+
+/*
+ * Description :
+ * Returns the time spent asleep since POWER_init in 1/1000 of the total time.
+ */
+uint16 POWER_getSleepRatio(void);
+
+#endif /* POWER_H_ */
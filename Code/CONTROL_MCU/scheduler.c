@@ -0,0 +1,112 @@
+ /******************************************************************************
+ *
+ * Module: SCHEDULER
+ *
+ * File Name: scheduler.c
+ *
+ * Description: Source file for the cooperative run-to-completion scheduler, the interrupts post
+ *              events and the main loop runs their handlers by priority.
+ *
+ * Author: Mohamed Khaled.
+ *
+ *******************************************************************************/
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "scheduler.h"
+
+#if (SCHEDULER_MAX_EVENTS > 8)
+#error "The pending events are kept in one byte"
+#endif
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+
+/* Bit n is set while event n is pending, set by the interrupts. */
+static volatile uint8 g_pendingEvents = 0;
+static void (*g_eventHandlers[SCHEDULER_MAX_EVENTS])(void);
+static void (*g_idleHandler)(void) = NULL_PTR;
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+void SCHEDULER_init(void)
+{
+	g_pendingEvents = 0;
+	g_idleHandler = NULL_PTR;
+	for(uint8 event = 0; event < SCHEDULER_MAX_EVENTS; event++)
+	{
+		g_eventHandlers[event] = NULL_PTR;
+	}
+}
+
+void SCHEDULER_setHandler(uint8 event, void (*handler)(void))
+{
+	if(event < SCHEDULER_MAX_EVENTS)
+	{
+		g_eventHandlers[event] = handler;
+	}
+}
+
+void SCHEDULER_setIdleHandler(void (*handler)(void))
+{
+	g_idleHandler = handler;
+}
+
+void SCHEDULER_post(uint8 event)
+{
+	uint8 sreg = SREG;
+
+	cli();
+	g_pendingEvents |= (uint8)(1 << event);
+	SREG = sreg;
+}
+
+boolean SCHEDULER_runNext(void)
+{
+	uint8 event = 0;
+	uint8 sreg;
+
+	if(g_pendingEvents == 0)
+	{
+		return FALSE;
+	}
+	while(!(g_pendingEvents & (1 << event)))
+	{
+		event++;
+	}
+	/* The event is cleared before its handler runs, so a post during the handler isn't lost. */
+	sreg = SREG;
+	cli();
+	g_pendingEvents &= (uint8)~(1 << event);
+	SREG = sreg;
+
+	if(g_eventHandlers[event] != NULL_PTR)
+	{
+		(*g_eventHandlers[event])();
+	}
+	return TRUE;
+}
+
+void SCHEDULER_run(void)
+{
+	uint8 sreg;
+
+	while(1)
+	{
+		if(SCHEDULER_runNext() || (g_idleHandler == NULL_PTR))
+		{
+			continue;
+		}
+		/* An event posted by an interrupt after the check would wait for the next wake up. */
+		sreg = SREG;
+		cli();
+		if(g_pendingEvents == 0)
+		{
+			(*g_idleHandler)();
+		}
+		SREG = sreg;
+	}
+}
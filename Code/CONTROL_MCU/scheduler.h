@@ -0,0 +1,74 @@
+ /******************************************************************************
+ *
+ * Module: SCHEDULER
+ *
+ * File Name: scheduler.h
+ *
+ * Description: Header file for the cooperative run-to-completion scheduler, the interrupts post
+ *              events and the main loop runs their handlers by priority.
+ *
+ * Author: Mohamed Khaled.
+ *
+ *******************************************************************************/
+
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/*
+ * Events are numbered from 0, the event number is its priority, 0 is the highest.
+ * The pending events are kept as bits, so an event posted again before its handler runs is
+ * handled once, the handler should consume all the work of its source (all the received frames...).
+ */
+#define SCHEDULER_MAX_EVENTS              8
+
+/*******************************************************************************
+ *                      Functions Prototypes                                   *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Clears the pending events and the handlers.
+ */
+void SCHEDULER_init(void);
+
+/*
+ * Description :
+ * Sets the function that handles the event, it runs to completion in the main loop and
+ * should not wait for anything, a long job is split into steps by posting the event again.
+ */
+void SCHEDULER_setHandler(uint8 event, void (*handler)(void));
+
+/*
+ * Description :
+ * Marks the event as pending, it can be called from the interrupts.
+ */
+void SCHEDULER_post(uint8 event);
+
+/*
+ * Description :
+ * Runs the handler of the highest priority pending event.
+ * Returns FALSE if there is no pending event.
+ */
+boolean SCHEDULER_runNext(void);
+
+/*
+ * Description :
+ * Sets the function called by SCHEDULER_run when no event is pending. It is called with the interrupts
+ * disabled, so no event is posted after the check, it enables them and sleeps until an interrupt.
+ */
+void SCHEDULER_setIdleHandler(void (*handler)(void));
+
+/*
+ * Description :
+ * Runs the pending events forever, after each handler the highest priority event is taken again,
+ * so an event is delayed by one handler at most. The idle handler is called when no event is pending.
+ */
+void SCHEDULER_run(void);
+
+#endif /* SCHEDULER_H_ */
@@ -0,0 +1,114 @@
+ /******************************************************************************
+ *
+ * Module: SOFTWARE TIMER
+ *
+ * File Name: sw_timer.h
+ *
+ * Description: Header file for the software timers, one-shot and periodic timers in a
+ *              hierarchical timer wheel driven by the 1 ms system tick of timer 1.
+ *
+ * Author: Mohamed Khaled.
+ *
+ *******************************************************************************/
+
+#ifndef SW_TIMER_H_
+#define SW_TIMER_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/*
+ * Number of timers that can be created, each one takes 9 bytes of RAM.
+ * The handles are uint8, so up to 254 timers can be configured.
+ */
+#ifndef SWTIMER_MAX_TIMERS
+#define SWTIMER_MAX_TIMERS                8
+#endif
+
+#if ((SWTIMER_MAX_TIMERS == 0) || (SWTIMER_MAX_TIMERS > 254))
+#error "SWTIMER_MAX_TIMERS must be from 1 to 254"
+#endif
+
+/* Returned by SWTIMER_create if all the timers are created. */
+#define SWTIMER_INVALID_HANDLE            0xFF
+
+/* Returned by SWTIMER_getIdleTime if no timer is running. */
+#define SWTIMER_NO_EXPIRY                 0xFFFF
+
+/*
+ * The wheel has 4 levels of 16 slots, the level n slot covers 16^n ms, so the 16-bit time covers 65536 ms.
+ * The delay and the period are limited so an armed timer never falls in a slot that is already passed.
+ */
+#define SWTIMER_LEVELS                    4
+#define SWTIMER_LEVEL_BITS                4
+#define SWTIMER_MAX_INTERVAL_MS           0xF000
+
+/*******************************************************************************
+ *                               Types Declaration                             *
+ *******************************************************************************/
+
+typedef uint8 SWTIMER_Handle;
+
+/*******************************************************************************
+ *                      Functions Prototypes                                   *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Frees all the timers, starts the system tick and sets SWTIMER_tick as the timer 1 callback.
+ */
+void SWTIMER_init(void);
+
+/*
+ * Description :
+ * Reserves a stopped timer that calls the callback on expiry, the callback is called with the interrupts
+ * disabled from the tick interrupt, or from the main loop for the ticks passed in a sleep, so it should be short.
+ * Returns SWTIMER_INVALID_HANDLE if no timer is free.
+ */
+SWTIMER_Handle SWTIMER_create(void (*callBack)(void));
+
+/*
+ * Description :
+ * Arms the timer to expire after delayMs (1 to SWTIMER_MAX_INTERVAL_MS, 0 is taken as 1), then each
+ * periodMs if it isn't 0. A running timer is restarted. It takes the same time for any number of timers.
+ */
+void SWTIMER_start(SWTIMER_Handle handle, uint16 delayMs, uint16 periodMs);
+
+/*
+ * Description :
+ * Stops the timer if it is running, its callback is not called after this.
+ */
+void SWTIMER_stop(SWTIMER_Handle handle);
+
+/*
+ * Description :
+ * Returns TRUE if the timer is armed.
+ */
+boolean SWTIMER_isRunning(SWTIMER_Handle handle);
+
+/*
+ * Description :
+ * Sets a function called at each tick before the expired timers, for the ms counters of the application.
+ * It is called in the same context as the timer callbacks.
+ */
+void SWTIMER_setTickCallBack(void (*callBack)(void));
+
+/*
+ * Description :
+ * Returns the number of ticks until the next timer expiry, 1 if it expires at the next tick, or
+ * SWTIMER_NO_EXPIRY if no timer is running. It checks all the timers, it's used before sleeping.
+ */
+uint16 SWTIMER_getIdleTime(void);
+
+/*
+ * Description :
+ * Advances the wheel by 1 ms and calls the callbacks of the expired timers.
+ * It is called by the system tick, or by the 1 ms tick of the application if SWTIMER_init is not used.
+ * It must not run while an interrupt starts or stops a timer.
+ */
+void SWTIMER_tick(void);
+
+#endif /* SW_TIMER_H_ */
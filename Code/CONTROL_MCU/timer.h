@@ -20,6 +20,35 @@
 #include "std_types.h"
 
 
+/***********************************************************************
+*                              Definitions                             *
+***********************************************************************/
+#ifndef F_CPU
+#define F_CPU 8000000UL
+#endif
+
+/*
+ * Timer 1 runs all the time after TIMER_startSystemTick as the system tick, with a compare
+ * interrupt each 1 ms. Its counter gives the time inside the ms.
+ * The timer 1 callback is called from the tick interrupt each 1 ms.
+ */
+#define TIMER_SYSTEM_TICK_COUNTS         ((F_CPU) / 8UL / 1000UL)
+
+#if ((TIMER_SYSTEM_TICK_COUNTS == 0) || (TIMER_SYSTEM_TICK_COUNTS > 65536UL))
+#error "F_CPU doesn't fit the 1 ms system tick of timer 1"
+#endif
+
+/*
+ * Longest system tick in ms set by TIMER_stretchSystemTick, the counter of timer 1 is 16 bits.
+ * The callback is still called once for each ms, all together after the CPU wakes up.
+ */
+#if ((65536UL / TIMER_SYSTEM_TICK_COUNTS) > 255UL)
+#define TIMER_MAX_SYSTEM_TICK_MS         255
+#else
+#define TIMER_MAX_SYSTEM_TICK_MS         (65536UL / TIMER_SYSTEM_TICK_COUNTS)
+#endif
+
+
 /***********************************************************************
 *                           User defined Types                         *
 ***********************************************************************/
@@ -84,10 +113,50 @@ void TIMER_setCallBack( void(*a_ptr)( void ), TIMER_ID timerID);
 /*
  * Description:
  * Stops the timer by stopping its clock.
+ * Timer 1 is not stopped while it is the system tick.
  */
 void TIMER_Deinit( TIMER_ID timerID );
 
 
+/*
+ * Description:
+ * Starts timer 1 as the free running system tick if it is not started yet.
+ */
+void TIMER_startSystemTick( void );
+
+
+/*
+ * Description:
+ * Returns the time in ms since the system tick is started, it wraps around after about 49 days.
+ */
+uint32 TIMER_millis( void );
+
+
+/*
+ * Description:
+ * Returns the time in us since the system tick is started, it wraps around after about 71 minutes.
+ */
+uint32 TIMER_micros( void );
+
+
+/*
+ * Description:
+ * Makes the current system tick end after ms (up to TIMER_MAX_SYSTEM_TICK_MS) instead of 1 ms, so the
+ * CPU can sleep without being woken each 1 ms. It must be called with the interrupts disabled right
+ * before sleeping, it does nothing if the tick is about to end.
+ */
+void TIMER_stretchSystemTick( uint8 ms );
+
+
+/*
+ * Description:
+ * Called after the CPU is woken up, by the end of the stretched tick or by another interrupt.
+ * The stretched tick ends and the callback is called for each ms that is passed, with the interrupts
+ * disabled as in the ISR, so the time seen by the application is late by 1 ms at most. The next ticks are 1 ms.
+ */
+void TIMER_resumeSystemTick( void );
+
+
 
 
 #endif /* TIMER_H_ */
@@ -14,6 +14,32 @@
 
 #include "common_macros.h"
 #include <avr/io.h>
+#include <avr/interrupt.h>
+
+/* TWI pins of ATmega16 in PORTC, driven by software only to recover the bus. */
+#define TWI_SCL_PIN 0
+#define TWI_SDA_PIN 1
+/* Clocks that make a slave finish the byte it was sending when the master was reset. */
+#define TWI_RECOVERY_CLOCKS 9
+
+/* Bytes sent or received since the last TWI_resetTransferCount, updated by the TWI ISR. */
+static volatile uint16 g_transferCount = 0;
+/* Submitted transactions, the head is the one under execution. */
+static TWI_Transaction* volatile g_queueHead = NULL_PTR;
+static TWI_Transaction* volatile g_queueTail = NULL_PTR;
+/* Progress of the current transaction, changed by the TWI ISR. */
+static volatile uint8 g_index = 0;
+static volatile boolean g_subAddressSent = FALSE;
+static volatile boolean g_reading = FALSE;
+/* Remaining time of the current transaction in ms, 0 if it has no timeout. */
+static volatile uint8 g_timeLeft = 0;
+/* Called after any transaction ends, so the application can run the next step. */
+static void (*volatile g_doneCallBackPtr)(void) = NULL_PTR;
+
+static void TWI_startTransaction(uint8 control);
+static void TWI_finish(TWI_ResultType result, boolean sendStop);
+static void TWI_recoverBus(void);
+static void TWI_recoveryDelay(void);
 
 void TWI_init( TWI_ConfigType* config )
 {
@@ -67,6 +93,7 @@ void TWI_writeByte(uint8 data)
     TWCR = (1 << TWINT) | (1 << TWEN);
     /* Wait for TWINT flag set in TWCR Register(data is send successfully) */
     while(BIT_IS_CLEAR(TWCR,TWINT));
+    g_transferCount++;
 }
 
 uint8 TWI_readByteWithACK(void)
@@ -79,6 +106,7 @@ uint8 TWI_readByteWithACK(void)
     TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWEA);
     /* Wait for TWINT flag set in TWCR Register (data received successfully) */
     while(BIT_IS_CLEAR(TWCR,TWINT));
+    g_transferCount++;
     /* Read Data */
     return TWDR;
 }
@@ -92,6 +120,7 @@ uint8 TWI_readByteWithNACK(void)
     TWCR = (1 << TWINT) | (1 << TWEN);
     /* Wait for TWINT flag set in TWCR Register (data received successfully) */
     while(BIT_IS_CLEAR(TWCR,TWINT));
+    g_transferCount++;
     /* Read Data */
     return TWDR;
 }
@@ -103,3 +132,250 @@ uint8 TWI_getStatus(void)
     status = TWSR & 0xF8;
     return status;
 }
+
+uint16 TWI_getTransferCount(void)
+{
+    uint16 count;
+    uint8 sreg = SREG;
+    /* The counter is 16 bits and updated by the TWI ISR, so read it atomically. */
+    cli();
+    count = g_transferCount;
+    SREG = sreg;
+    return count;
+}
+
+void TWI_resetTransferCount(void)
+{
+    uint8 sreg = SREG;
+    cli();
+    g_transferCount = 0;
+    SREG = sreg;
+}
+
+void TWI_submit(TWI_Transaction* transaction)
+{
+    uint8 sreg = SREG;
+
+    transaction->result = TWI_PENDING;
+    transaction->next = NULL_PTR;
+    cli();
+    if (g_queueHead == NULL_PTR)
+    {
+        g_queueHead = transaction;
+        g_queueTail = transaction;
+        /* The STOP of the previous transaction may still be under execution. */
+        while(BIT_IS_SET(TWCR,TWSTO));
+        TWI_startTransaction((1 << TWINT) | (1 << TWSTA) | (1 << TWEN) | (1 << TWIE));
+    }
+    else
+    {
+        g_queueTail->next = transaction;
+        g_queueTail = transaction;
+    }
+    SREG = sreg;
+}
+
+TWI_ResultType TWI_wait(TWI_Transaction* transaction)
+{
+    while(transaction->result == TWI_PENDING);
+    return transaction->result;
+}
+
+boolean TWI_isIdle(void)
+{
+    return (g_queueHead == NULL_PTR);
+}
+
+void TWI_setDoneCallBack(void(*a_ptr)(void))
+{
+    g_doneCallBackPtr = a_ptr;
+}
+
+void TWI_timerTick(void)
+{
+    if ((g_queueHead == NULL_PTR) || (g_timeLeft == 0))
+    {
+        return;
+    }
+    g_timeLeft--;
+    if (g_timeLeft == 0)
+    {
+        /* Either a slave stretches the clock forever or the bus is held, so it is released by force. */
+        TWI_recoverBus();
+        TWI_finish(TWI_TIMEOUT, FALSE);
+    }
+}
+
+/*
+ * Resets the progress for the transaction at the queue head and writes control to TWCR,
+ * which sends the start condition of the transaction.
+ */
+static void TWI_startTransaction(uint8 control)
+{
+    g_index = 0;
+    g_subAddressSent = FALSE;
+    g_reading = (g_queueHead->type == TWI_READ);
+    g_timeLeft = g_queueHead->timeout;
+    TWCR = control;
+}
+
+/*
+ * Ends the transaction at the queue head by result, then starts the next one if any.
+ * sendStop is FALSE when the bus is already released by TWI_recoverBus.
+ */
+static void TWI_finish(TWI_ResultType result, boolean sendStop)
+{
+    TWI_Transaction* transaction = g_queueHead;
+
+    g_queueHead = transaction->next;
+    if (g_queueHead == NULL_PTR)
+    {
+        g_queueTail = NULL_PTR;
+        g_timeLeft = 0;
+        if (sendStop)
+        {
+            TWCR = (1 << TWINT) | (1 << TWSTO) | (1 << TWEN);
+        }
+    }
+    else if (sendStop)
+    {
+        /* STOP followed by START of the next transaction. */
+        TWI_startTransaction((1 << TWINT) | (1 << TWSTO) | (1 << TWSTA) | (1 << TWEN) | (1 << TWIE));
+    }
+    else
+    {
+        TWI_startTransaction((1 << TWINT) | (1 << TWSTA) | (1 << TWEN) | (1 << TWIE));
+    }
+
+    transaction->result = result;
+    if (transaction->callBack != NULL_PTR)
+    {
+        transaction->callBack(transaction);
+    }
+    if (g_doneCallBackPtr != NULL_PTR)
+    {
+        g_doneCallBackPtr();
+    }
+}
+
+/*
+ * Takes the pins from the TWI module, clocks SCL till a slave holding SDA releases it,
+ * then generates a STOP condition and gives the pins back to the TWI module.
+ * The pins are driven as open drain by their direction, the bus pull-ups make them high.
+ */
+static void TWI_recoverBus(void)
+{
+    TWCR = 0;
+    CLEAR_BIT(PORTC,TWI_SCL_PIN);
+    CLEAR_BIT(PORTC,TWI_SDA_PIN);
+    CLEAR_BIT(DDRC,TWI_SDA_PIN);
+    for (uint8 i = 0; i < TWI_RECOVERY_CLOCKS; i++)
+    {
+        SET_BIT(DDRC,TWI_SCL_PIN);
+        TWI_recoveryDelay();
+        CLEAR_BIT(DDRC,TWI_SCL_PIN);
+        TWI_recoveryDelay();
+    }
+    /* STOP condition: SDA goes high while SCL is high. */
+    SET_BIT(DDRC,TWI_SCL_PIN);
+    SET_BIT(DDRC,TWI_SDA_PIN);
+    TWI_recoveryDelay();
+    CLEAR_BIT(DDRC,TWI_SCL_PIN);
+    TWI_recoveryDelay();
+    CLEAR_BIT(DDRC,TWI_SDA_PIN);
+    TWI_recoveryDelay();
+    TWCR = (1 << TWEN);
+}
+
+/* Half period of the recovery clock, about 5us at 8MHz. */
+static void TWI_recoveryDelay(void)
+{
+    for (volatile uint8 i = 0; i < 8; i++);
+}
+
+ISR(TWI_vect)
+{
+    TWI_Transaction* transaction = g_queueHead;
+    uint8 status = TWI_getStatus();
+
+    if (transaction == NULL_PTR)
+    {
+        /* Nothing to execute, stop the interrupts of the module. */
+        TWCR = (1 << TWEN);
+        return;
+    }
+    if ((status != TWI_START) && (status != TWI_REP_START) && (status != TWI_BUS_ERROR) && (status != TWI_ARB_LOST))
+    {
+        g_transferCount++;
+    }
+
+    switch (status)
+    {
+    case TWI_START:
+    case TWI_REP_START:
+        TWDR = transaction->slaveAddress | (g_reading ? 1 : 0);
+        TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWIE);
+        break;
+    case TWI_MT_SLA_W_ACK:
+    case TWI_MT_DATA_ACK:
+        if (transaction->useSubAddress && !g_subAddressSent)
+        {
+            g_subAddressSent = TRUE;
+            TWDR = transaction->subAddress;
+            TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWIE);
+        }
+        else if (g_index < transaction->writeLength)
+        {
+            TWDR = transaction->writeData[g_index++];
+            TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWIE);
+        }
+        else if (transaction->type == TWI_WRITE_READ)
+        {
+            /* Repeated start keeps the bus for the read phase. */
+            g_reading = TRUE;
+            g_index = 0;
+            TWCR = (1 << TWINT) | (1 << TWSTA) | (1 << TWEN) | (1 << TWIE);
+        }
+        else
+        {
+            TWI_finish(TWI_DONE, TRUE);
+        }
+        break;
+    case TWI_MT_SLA_R_ACK:
+        /* The last byte is not acknowledged to end the read. */
+        if (transaction->readLength > 1)
+        {
+            TWCR = (1 << TWINT) | (1 << TWEA) | (1 << TWEN) | (1 << TWIE);
+        }
+        else
+        {
+            TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWIE);
+        }
+        break;
+    case TWI_MR_DATA_ACK:
+        transaction->readData[g_index++] = TWDR;
+        if ((uint8)(g_index + 1) < transaction->readLength)
+        {
+            TWCR = (1 << TWINT) | (1 << TWEA) | (1 << TWEN) | (1 << TWIE);
+        }
+        else
+        {
+            TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWIE);
+        }
+        break;
+    case TWI_MR_DATA_NACK:
+        transaction->readData[g_index++] = TWDR;
+        TWI_finish(TWI_DONE, TRUE);
+        break;
+    case TWI_MT_SLA_W_NACK:
+    case TWI_MT_DATA_NACK:
+    case TWI_MT_SLA_R_NACK:
+        TWI_finish(TWI_NACK, TRUE);
+        break;
+    default:
+        /* Bus error, lost arbitration or unexpected state. */
+        TWI_recoverBus();
+        TWI_finish(TWI_FAILED, FALSE);
+        break;
+    }
+}
@@ -27,6 +27,11 @@
 #define TWI_MT_DATA_ACK   0x28 /* Master transmit data and ACK has been received from Slave. */
 #define TWI_MR_DATA_ACK   0x50 /* Master received data and send ACK to slave. */
 #define TWI_MR_DATA_NACK  0x58 /* Master received data but doesn't send ACK to slave. */
+#define TWI_MT_SLA_W_NACK 0x20 /* Master transmit ( slave address + Write request ) to slave + NACK received from slave. */
+#define TWI_MT_DATA_NACK  0x30 /* Master transmit data and NACK has been received from Slave. */
+#define TWI_ARB_LOST      0x38 /* Arbitration lost while sending the address or the data. */
+#define TWI_MT_SLA_R_NACK 0x48 /* Master transmit ( slave address + Read request ) to slave + NACK received from slave. */
+#define TWI_BUS_ERROR     0x00 /* Illegal START or STOP condition on the bus. */
 
 
 /*******************************************************************************
@@ -43,6 +48,41 @@ typedef struct
 	uint8 address;
 } TWI_ConfigType;
 
+typedef enum
+{
+	TWI_WRITE, TWI_READ, TWI_WRITE_READ
+} TWI_TransferType;
+
+typedef enum
+{
+	TWI_PENDING, TWI_DONE, TWI_NACK, TWI_FAILED, TWI_TIMEOUT
+} TWI_ResultType;
+
+/*
+ * Description:
+ * Transaction executed by the TWI ISR, it is owned by the driver from TWI_submit till its
+ * result is not TWI_PENDING, so it and its buffers must stay valid till then.
+ * TWI_WRITE sends subAddress (if useSubAddress) then writeData.
+ * TWI_READ reads readLength bytes, readLength must not be 0 for the read types.
+ * TWI_WRITE_READ sends subAddress (if useSubAddress) and writeData then reads by a repeated start.
+ * callBack is called from the ISR when the transaction ends, it may be NULL_PTR.
+ */
+typedef struct TWI_Transaction
+{
+	TWI_TransferType type;
+	uint8 slaveAddress;					/* Slave address with R/W bit = 0 (SLA+W). */
+	boolean useSubAddress;
+	uint8 subAddress;					/* Memory location or register sent before writeData. */
+	const uint8* writeData;
+	uint8 writeLength;
+	uint8* readData;
+	uint8 readLength;
+	uint8 timeout;						/* ms, counted by TWI_timerTick from the start of the transaction. */
+	void (*callBack)(struct TWI_Transaction* transaction);
+	volatile TWI_ResultType result;
+	struct TWI_Transaction* next;		/* Used by the driver queue. */
+} TWI_Transaction;
+
 
 /*******************************************************************************
  *                      Functions Prototypes                                   *
@@ -54,6 +94,24 @@ void TWI_writeByte(uint8 data);
 uint8 TWI_readByteWithACK(void);
 uint8 TWI_readByteWithNACK(void);
 uint8 TWI_getStatus(void);
+/*
+ * The blocking functions above must only be used while TWI_isIdle returns TRUE,
+ * the transactions are executed by the TWI ISR in the order they are submitted.
+ */
+void TWI_submit(TWI_Transaction* transaction);
+/* Waits till the transaction ends and returns its result, interrupts must be enabled. */
+TWI_ResultType TWI_wait(TWI_Transaction* transaction);
+boolean TWI_isIdle(void);
+/* Sets the function called from the ISR after any transaction ends, after its own callBack. */
+void TWI_setDoneCallBack(void(*a_ptr)(void));
+/*
+ * Must be called every 1ms, aborts the current transaction when its timeout passes and
+ * recovers the bus in case a slave keeps holding it.
+ */
+void TWI_timerTick(void);
+/* Number of bytes sent or received on the bus including the address bytes, used to measure the drivers. */
+uint16 TWI_getTransferCount(void);
+void TWI_resetTransferCount(void);
 
 
 #endif /* TWI_H_ */
@@ -13,6 +13,90 @@
 #include "uart.h"
 #include "avr/io.h" /* To use the UART Registers */
 #include "common_macros.h" /* To use the macros like SET_BIT */
+#include <avr/interrupt.h> /* For the UART ISRs */
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+
+/* The selected mode of the UART, polling or interrupt. */
+static UART_Mode g_mode = UART_POLLING_MODE;
+
+/*
+ * Ring buffers used in interrupt mode.
+ * The head index is only written by the producer and the tail index is only written
+ * by the consumer, so one side is always the ISR and the other is the application.
+ */
+static volatile uint8 g_rxBuffer[UART_RX_BUFFER_SIZE];
+static volatile uint8 g_rxHead = 0;
+static volatile uint8 g_rxTail = 0;
+
+static volatile uint8 g_txBuffer[UART_TX_BUFFER_SIZE];
+static volatile uint8 g_txHead = 0;
+static volatile uint8 g_txTail = 0;
+
+/* 9-bit data mode is used for multi-processor communication. */
+static boolean g_nineDataBits = FALSE;
+
+/* Address of this node in multi-processor communication mode. */
+static volatile uint8 g_nodeAddress = UART_NO_NODE_ADDRESS;
+
+/* Set when a byte is written to UDR, cleared by UART_flush after TXC. */
+static volatile boolean g_txStarted = FALSE;
+
+/* Overflow counters. */
+static volatile uint16 g_rxOverflowCount = 0;
+static volatile uint16 g_txOverflowCount = 0;
+
+#if (UART_ERROR_INJECTION_RATE > 0)
+/* State of the pseudo random generator of the error injection and its counter. */
+static volatile uint16 g_injectionLfsr = 0xACE1;
+static volatile uint16 g_injectedErrorCount = 0;
+#endif
+
+/* Receives the data bytes in the RX ISR instead of the RX ring buffer if it is set. */
+static void (*volatile g_rxCallBackPtr)(uint8 data) = NULL_PTR;
+
+/*******************************************************************************
+ *                      Functions Prototypes(Private)                          *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Put one byte in the TX ring buffer and enable the data register empty interrupt.
+ * Returns FALSE if the buffer is full.
+ */
+static boolean UART_enqueueByte(const uint8 data);
+
+/*
+ * Description :
+ * Handle the address frames of multi-processor communication mode.
+ * Returns TRUE if the received byte is data that should be passed to the application.
+ */
+static boolean UART_acceptByte(const uint8 ninthBit, const uint8 data);
+
+#if (UART_ERROR_INJECTION_RATE > 0)
+/*
+ * Description :
+ * Corrupt the received byte at UART_ERROR_INJECTION_RATE, returns FALSE if it should be dropped.
+ */
+static boolean UART_injectError(uint8 *data);
+#endif
+
+/*
+ * Description :
+ * Calculate the UBRR value and select normal or double speed for the required baud rate.
+ * The speed mode with the lower error is selected, returns FALSE if the error of both
+ * modes exceeds UART_MAX_BAUD_ERROR.
+ */
+static boolean UART_calculateBaudRate(uint32 bitRate, uint16 *ubrr_value, boolean *doubleSpeed);
+
+/*
+ * Description :
+ * Returns the baud rate error in 0.1% units of the given clock divisor,
+ * 0xFFFF if the divisor is out of the UBRR range.
+ */
+static uint16 UART_calculateBaudError(uint32 clock, uint32 divisor, uint32 bitRate);
 
 /*******************************************************************************
  *                      Functions Definitions                                  *
@@ -23,68 +107,225 @@
  * Functional responsible for Initialize the UART device by:
  * 1. Setup the Frame format like number of data bits, parity bit type and number of stop bits.
  * 2. Enable the UART.
- * 3. Setup the UART baud rate.
+ * 3. Setup the UART baud rate, the speed mode (U2X) with the lower error is selected.
  */
 void UART_init( UART_ConfigType* config )
 {
-	uint16 ubrr_value = 0;
+	uint8 ucsrc_value;
 
-	/* U2X = 1 for double transmission speed */
-	UCSRA = (1<<U2X);
+	/* U2X is selected later with the baud rate, MPCM is set later by UART_setNodeAddress. */
+	UCSRA = 0;
+	g_nodeAddress = UART_NO_NODE_ADDRESS;
 
 	/************************** UCSRB Description **************************
-	 * RXCIE = 0 Disable USART RX Complete Interrupt Enable
+	 * RXCIE = 0 Disable USART RX Complete Interrupt Enable (enabled later in interrupt mode)
 	 * TXCIE = 0 Disable USART Tx Complete Interrupt Enable
-	 * UDRIE = 0 Disable USART Data Register Empty Interrupt Enable
+	 * UDRIE = 0 Disable USART Data Register Empty Interrupt Enable (enabled when TX buffer has data)
 	 * RXEN  = 1 Receiver Enable
 	 * RXEN  = 1 Transmitter Enable
 	 * UCSZ2 = 0 initially and i will change it later while i select the data bits.
-	 * RXB8 & TXB8 not used for 8-bit data mode /////////
+	 * RXB8 & TXB8 used in 9-bit data mode to mark address frames
 	 ***********************************************************************/ 
 	UCSRB = (1<<RXEN) | (1<<TXEN);
+
+	/* Reset the ring buffers and enable the RX complete interrupt in interrupt mode. */
+	g_mode = config->mode;
+	g_rxHead = g_rxTail = 0;
+	g_txHead = g_txTail = 0;
+	if(g_mode == UART_INTERRUPT_MODE)
+	{
+		UCSRB |= (1<<RXCIE);
+	}
 	
 	/************************** UCSRC Description **************************
 	 * URSEL   = 1 The URSEL must be one when writing the UCSRC
 	 * UMSEL   = 0 Asynchronous Operation
 	 * UPM1:0  = inserted at bits 4:5 according to configurations
 	 * USBS    = inserted according to configurations
-	 * UCSZ1:0 = 11 For 8-bit data mode /////////////////////
+	 * UCSZ1:0 = inserted according to the required data bits
 	 * UCPOL   = 0 Used with the Synchronous operation only
 	 ***********************************************************************/ 	
-	/* Insert the value of parity type in bits 5:4, and number of stop bits according to configurations.*/
-	UCSRC = (1<<URSEL) | ((UCSRC&~(0x30))|((config->parity)<<4)) | ((config->stopBits)<<USBS);
+	/*
+	 * Insert the value of parity type in bits 5:4, and number of stop bits according to configurations.
+	 * UCSRC shares its address with UBRRH and reading it back returns UBRRH, so the whole
+	 * value is built first and written once with URSEL = 1.
+	 */
+	ucsrc_value = (1<<URSEL) | ((config->parity)<<UPM0) | ((config->stopBits)<<USBS);
 
 	/* Configure registers according to required data bits*/
+	g_nineDataBits = FALSE;
 	switch(config->dataLength)
 	{
 	case BITS_5:
 	case BITS_6:
 	case BITS_7:
 	case BITS_8:
-		/* Keep UCSZ2 at UCSRB register 0 as it is and insert number of bits on UCSRC register at first 2 bits.*/
-		UCSRC = (UCSRC&~(0x03))|(config->dataLength);
+		/* Keep UCSZ2 at UCSRB register 0 as it is and insert number of bits on UCSZ1:0 bits.*/
+		ucsrc_value |= (config->dataLength)<<UCSZ0;
 		break;
 	case BITS_9:
-		/* Set UCSZ2 at UCSRB register to 1 and insert 0b11 at first 2 bits.*/
+		/* Set UCSZ2 at UCSRB register to 1 and insert 0b11 at UCSZ1:0 bits.*/
 		UCSRB |= (1<<UCSZ2);
-		UCSRC |= 0x03;
+		ucsrc_value |= (0x03<<UCSZ0);
+		g_nineDataBits = TRUE;
 		break;
 	}
+	UCSRC = ucsrc_value;
 	
-	/* Calculate the UBRR register value */
-	ubrr_value = (uint16)(((F_CPU / (config->bitRate * 8UL))) - 1);
+	/* Calculate the UBRR register value and select normal or double speed. */
+	UART_setBaudRate(config->bitRate);
+}
+
+/*
+ * Description :
+ * Returns TRUE if the required baud rate can be generated from F_CPU within UART_MAX_BAUD_ERROR.
+ */
+boolean UART_isBaudRateValid(uint32 bitRate)
+{
+	uint16 ubrr_value;
+	boolean doubleSpeed;
+
+	return UART_calculateBaudRate(bitRate, &ubrr_value, &doubleSpeed);
+}
+
+/*
+ * Description :
+ * Calculate the UBRR value and the U2X bit of the required baud rate and apply them.
+ * Returns FALSE and keeps the current rate if the error exceeds UART_MAX_BAUD_ERROR.
+ */
+boolean UART_setBaudRate(uint32 bitRate)
+{
+	uint16 ubrr_value;
+	boolean doubleSpeed;
+
+	if(!UART_calculateBaudRate(bitRate, &ubrr_value, &doubleSpeed))
+	{
+		return FALSE;
+	}
+	/* TXC is written 0 so the read-modify-write doesn't clear it. */
+	if(doubleSpeed)
+	{
+		UCSRA = (UCSRA & ~(1<<TXC)) | (1<<U2X);
+	}
+	else
+	{
+		UCSRA = UCSRA & ~((1<<TXC) | (1<<U2X));
+	}
 
 	/* First 8 bits from the BAUD_PRESCALE inside UBRRL and last 4 bits in UBRRH*/
 	UBRRH = ubrr_value>>8;
 	UBRRL = ubrr_value;
+	return TRUE;
+}
+
+/*
+ * Description :
+ * Wait until all the queued bytes are completely shifted out of the UART,
+ * used before changing the baud rate or the frame format.
+ */
+void UART_flush(void)
+{
+	/* Wait for the ISR to empty the TX ring buffer. */
+	while(g_txHead != g_txTail){}
+
+	/* TXC is cleared each time a byte is written to UDR, so it is set only after the last byte. */
+	if(g_txStarted)
+	{
+		while(BIT_IS_CLEAR(UCSRA,TXC)){}
+		g_txStarted = FALSE;
+	}
+}
+
+/*
+ * Description :
+ * Calculate the UBRR value and select normal or double speed for the required baud rate.
+ * The speed mode with the lower error is selected, returns FALSE if the error of both
+ * modes exceeds UART_MAX_BAUD_ERROR.
+ */
+static boolean UART_calculateBaudRate(uint32 bitRate, uint16 *ubrr_value, boolean *doubleSpeed)
+{
+	uint32 divisorNormal;
+	uint32 divisorDouble;
+	uint16 errorNormal;
+	uint16 errorDouble;
+
+	if(bitRate == 0)
+	{
+		return FALSE;
+	}
+
+	/* Rounded (UBRR + 1) for normal speed (clock / 16) and double speed (clock / 8). */
+	divisorNormal = (F_CPU + 8UL * bitRate) / (16UL * bitRate);
+	divisorDouble = (F_CPU + 4UL * bitRate) / (8UL * bitRate);
+	errorNormal = UART_calculateBaudError(F_CPU / 16UL, divisorNormal, bitRate);
+	errorDouble = UART_calculateBaudError(F_CPU / 8UL, divisorDouble, bitRate);
+
+	/* Prefer normal speed on equal errors as it samples each bit more times. */
+	if(errorNormal <= errorDouble)
+	{
+		*ubrr_value = (uint16)(divisorNormal - 1);
+		*doubleSpeed = FALSE;
+		return (errorNormal <= UART_MAX_BAUD_ERROR);
+	}
+	*ubrr_value = (uint16)(divisorDouble - 1);
+	*doubleSpeed = TRUE;
+	return (errorDouble <= UART_MAX_BAUD_ERROR);
+}
+
+/*
+ * Description :
+ * Returns the baud rate error in 0.1% units of the given clock divisor,
+ * 0xFFFF if the divisor is out of the UBRR range.
+ */
+static uint16 UART_calculateBaudError(uint32 clock, uint32 divisor, uint32 bitRate)
+{
+	uint32 actualRate;
+	uint32 difference;
+
+	if((divisor == 0) || (divisor > 4096))
+	{
+		return 0xFFFF;
+	}
+	actualRate = clock / divisor;
+	difference = (actualRate > bitRate) ? (actualRate - bitRate) : (bitRate - actualRate);
+	return (uint16)((difference * 1000UL) / bitRate);
+}
+
+/*
+ * Description :
+ * Put one byte in the TX ring buffer and enable the data register empty interrupt.
+ * Returns FALSE if the buffer is full.
+ */
+static boolean UART_enqueueByte(const uint8 data)
+{
+	uint8 nextHead = (g_txHead + 1) & (UART_TX_BUFFER_SIZE - 1);
+
+	if(nextHead == g_txTail)
+	{
+		return FALSE;
+	}
+	g_txBuffer[g_txHead] = data;
+	g_txHead = nextHead;
+
+	/* The ISR disables UDRIE when the buffer becomes empty, so enable it again. */
+	SET_BIT(UCSRB,UDRIE);
+	return TRUE;
 }
 
 /*
  * Description :
  * Functional responsible for send byte to another UART device.
+ * In interrupt mode it only waits if the TX ring buffer is full.
  */
 void UART_sendByte(const uint8 data)
 {
+	if(g_mode == UART_INTERRUPT_MODE)
+	{
+		/* Wait until the ISR makes a room in the TX ring buffer. */
+		while(!UART_enqueueByte(data)){}
+		return;
+	}
+
 	/*
 	 * UDRE flag is set when the Tx buffer (UDR) is empty and ready for
 	 * transmitting a new byte so wait until this flag is set to one
@@ -93,9 +334,11 @@ void UART_sendByte(const uint8 data)
 
 	/*
 	 * Put the required data in the UDR register and it also clear the UDRE flag as
-	 * the UDR register is not empty now
+	 * the UDR register is not empty now, clear TXC so UART_flush can wait for this byte.
 	 */
+	SET_BIT(UCSRA,TXC);
 	UDR = data;
+	g_txStarted = TRUE;
 
 	/************************* Another Method *************************
 	UDR = data;
@@ -107,17 +350,253 @@ void UART_sendByte(const uint8 data)
 /*
  * Description :
  * Functional responsible for receive byte from another UART device.
+ * In interrupt mode it waits until the RX ring buffer has a byte.
  */
 uint8 UART_recieveByte(void)
 {
-	/* RXC flag is set when the UART receive data so wait until this flag is set to one */
-	while(BIT_IS_CLEAR(UCSRA,RXC)){}
+	uint8 data;
+
+	if(g_mode == UART_INTERRUPT_MODE)
+	{
+		/* Wait until the ISR puts a byte in the RX ring buffer. */
+		while(!UART_tryReceive(&data)){}
+		return data;
+	}
+
+	/* Receive until a data byte is received, address frames are handled internally. */
+	while(!UART_tryReceive(&data)){}
+	return data;
+}
+
+/*
+ * Description :
+ * Non-blocking receive, returns TRUE and stores the byte in data if one is available,
+ * otherwise returns FALSE immediately.
+ */
+boolean UART_tryReceive(uint8 *data)
+{
+	if(g_mode == UART_INTERRUPT_MODE)
+	{
+		if(g_rxHead == g_rxTail)
+		{
+			return FALSE;
+		}
+		*data = g_rxBuffer[g_rxTail];
+		g_rxTail = (g_rxTail + 1) & (UART_RX_BUFFER_SIZE - 1);
+		return TRUE;
+	}
+
+	/* RXC flag is set when the UART receive data */
+	if(BIT_IS_CLEAR(UCSRA,RXC))
+	{
+		return FALSE;
+	}
 
 	/*
-	 * Read the received data from the Rx buffer (UDR)
+	 * Read the received data from the Rx buffer (UDR), RXB8 must be read before UDR.
 	 * The RXC flag will be cleared after read the data
 	 */
-    return UDR;		
+	uint8 ninthBit = UCSRB & (1<<RXB8);
+	*data = UDR;
+	if(!UART_acceptByte(ninthBit, *data))
+	{
+		return FALSE;
+	}
+#if (UART_ERROR_INJECTION_RATE > 0)
+	return UART_injectError(data);
+#else
+	return TRUE;
+#endif
+}
+
+/*
+ * Description :
+ * Non-blocking send, queues as many bytes as fit in the TX ring buffer and returns
+ * the number of queued bytes. The bytes that did not fit are counted as TX overflow.
+ * In polling mode all the bytes are sent before returning.
+ */
+uint8 UART_write(const uint8 *data, uint8 length)
+{
+	uint8 i;
+
+	for(i = 0; i < length; i++)
+	{
+		if(g_mode == UART_INTERRUPT_MODE)
+		{
+			if(!UART_enqueueByte(data[i]))
+			{
+				g_txOverflowCount += (length - i);
+				break;
+			}
+		}
+		else
+		{
+			UART_sendByte(data[i]);
+		}
+	}
+	return i;
+}
+
+/*
+ * Description :
+ * Returns the number of received bytes waiting in the RX ring buffer.
+ */
+uint8 UART_available(void)
+{
+	if(g_mode == UART_INTERRUPT_MODE)
+	{
+		return (g_rxHead - g_rxTail) & (UART_RX_BUFFER_SIZE - 1);
+	}
+	return BIT_IS_SET(UCSRA,RXC) ? 1 : 0;
+}
+
+/*
+ * Description :
+ * Returns the number of received bytes lost because the RX ring buffer was full
+ * or the hardware reported a data overrun.
+ */
+uint16 UART_getRxOverflowCount(void)
+{
+	uint16 count;
+	/* The counter is 16 bits and updated by the ISR, so read it atomically. */
+	uint8 sreg = SREG;
+	cli();
+	count = g_rxOverflowCount;
+	SREG = sreg;
+	return count;
+}
+
+/*
+ * Description :
+ * Returns the number of bytes refused by UART_write because the TX ring buffer was full.
+ */
+uint16 UART_getTxOverflowCount(void)
+{
+	return g_txOverflowCount;
+}
+
+/*
+ * Description :
+ * Returns the number of received bytes corrupted or dropped by the error injection,
+ * always 0 if UART_ERROR_INJECTION_RATE is 0.
+ */
+uint16 UART_getInjectedErrorCount(void)
+{
+#if (UART_ERROR_INJECTION_RATE > 0)
+	uint16 count;
+	/* The counter is 16 bits and updated by the ISR, so read it atomically. */
+	uint8 sreg = SREG;
+	cli();
+	count = g_injectedErrorCount;
+	SREG = sreg;
+	return count;
+#else
+	return 0;
+#endif
+}
+
+#if (UART_ERROR_INJECTION_RATE > 0)
+/*
+ * Description :
+ * Corrupt the received byte at UART_ERROR_INJECTION_RATE, returns FALSE if it should be dropped.
+ */
+static boolean UART_injectError(uint8 *data)
+{
+	/* 16-bit Galois LFSR, polynomial x^16 + x^14 + x^13 + x^11 + 1. */
+	uint16 lfsr = g_injectionLfsr;
+	lfsr = (lfsr >> 1) ^ ((lfsr & 1) ? 0xB400 : 0);
+	g_injectionLfsr = lfsr;
+
+	if((uint8)lfsr >= UART_ERROR_INJECTION_RATE)
+	{
+		return TRUE;
+	}
+	g_injectedErrorCount++;
+#if (UART_ERROR_INJECTION_DROP == TRUE)
+	return FALSE;
+#else
+	/* Flip one bit selected by the high byte of the generator. */
+	*data ^= (1 << ((lfsr >> 8) & 0x07));
+	return TRUE;
+#endif
+}
+#endif
+
+/*
+ * Description :
+ * Send an address frame (9th bit = 1) in multi-processor communication mode to select
+ * the node that receives the next data bytes. The UART should be in 9-bit data mode.
+ */
+void UART_sendAddress(const uint8 address)
+{
+	/* The 9th bit is taken from TXB8 when UDR moves to the shift register, so send the queued data first. */
+	UART_flush();
+	SET_BIT(UCSRB,TXB8);
+	SET_BIT(UCSRA,TXC);
+	UDR = address;
+	g_txStarted = TRUE;
+	/* The shift register is empty, so UDR moves to it immediately and UDRE is set again. */
+	while(BIT_IS_CLEAR(UCSRA,UDRE)){}
+	CLEAR_BIT(UCSRB,TXB8);
+}
+
+/*
+ * Description :
+ * Set the address of this node and enable multi-processor communication mode (MPCM).
+ * The hardware then ignores all data frames till an address frame with this address or
+ * UART_BROADCAST_ADDRESS is received. UART_NO_NODE_ADDRESS disables the filtering.
+ * The UART should be in 9-bit data mode.
+ */
+void UART_setNodeAddress(const uint8 address)
+{
+	g_nodeAddress = address;
+	/* TXC is written 0 so the read-modify-write doesn't clear it. */
+	if(address == UART_NO_NODE_ADDRESS)
+	{
+		UCSRA = UCSRA & ~((1<<TXC) | (1<<MPCM));
+	}
+	else
+	{
+		UCSRA = (UCSRA & ~(1<<TXC)) | (1<<MPCM);
+	}
+}
+
+/*
+ * Description :
+ * Handle the address frames of multi-processor communication mode.
+ * Returns TRUE if the received byte is data that should be passed to the application.
+ */
+static boolean UART_acceptByte(const uint8 ninthBit, const uint8 data)
+{
+	if(!g_nineDataBits || !ninthBit)
+	{
+		/* Data frame, with MPCM set the hardware doesn't receive data frames at all. */
+		return TRUE;
+	}
+	/* Address frame, wake up for our address or broadcast and go back to filtering for any other. */
+	if(g_nodeAddress != UART_NO_NODE_ADDRESS)
+	{
+		if((data == g_nodeAddress) || (data == UART_BROADCAST_ADDRESS))
+		{
+			UCSRA = UCSRA & ~((1<<TXC) | (1<<MPCM));
+		}
+		else
+		{
+			UCSRA = (UCSRA & ~(1<<TXC)) | (1<<MPCM);
+		}
+	}
+	return FALSE;
+}
+
+/*
+ * Description :
+ * Set the function called by the RX ISR with each received data byte in interrupt mode.
+ * While it is set, the received bytes are passed to it instead of the RX ring buffer,
+ * so a protocol layer can assemble its frames in the ISR. NULL_PTR restores the ring buffer.
+ */
+void UART_setRxCallBack(void(*a_ptr)(uint8 data))
+{
+	g_rxCallBackPtr = a_ptr;
 }
 
 /*
@@ -146,21 +625,94 @@ void UART_sendString(const uint8 *Str)
 /*
  * Description :
  * Receive the required string until the '#' symbol through UART from the other UART device.
+ * At most size - 1 characters are stored, the rest of a longer string is dropped till the '#'.
  */
-void UART_receiveString(uint8 *Str)
+void UART_receiveString(uint8 *Str, uint8 size)
 {
 	uint8 i = 0;
+	uint8 data;
 
-	/* Receive the first byte */
-	Str[i] = UART_recieveByte();
+	if(size == 0)
+	{
+		return;
+	}
 
 	/* Receive the whole string until the '#' */
-	while(Str[i] != '#')
+	data = UART_recieveByte();
+	while(data != '#')
 	{
-		i++;
-		Str[i] = UART_recieveByte();
+		if(i < (size - 1))
+		{
+			Str[i] = data;
+			i++;
+		}
+		data = UART_recieveByte();
 	}
 
-	/* After receiving the whole string plus the '#', replace the '#' with '\0' */
+	/* After receiving the whole string plus the '#', terminate it with '\0' */
 	Str[i] = '\0';
 }
+
+/*******************************************************************************
+ *                                ISRs code                                    *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * RX complete interrupt, moves the received byte from UDR to the RX ring buffer
+ * or passes it to the RX callback.
+ */
+ISR( USART_RXC_vect )
+{
+	/* The status flags and the 9th bit must be read before UDR. */
+	uint8 status = UCSRA;
+	uint8 ninthBit = UCSRB & (1<<RXB8);
+	uint8 data = UDR;
+	uint8 nextHead = (g_rxHead + 1) & (UART_RX_BUFFER_SIZE - 1);
+
+	if(BIT_IS_SET(status,DOR))
+	{
+		g_rxOverflowCount++;
+	}
+	if(!UART_acceptByte(ninthBit, data))
+	{
+		return;
+	}
+#if (UART_ERROR_INJECTION_RATE > 0)
+	if(!UART_injectError(&data))
+	{
+		return;
+	}
+#endif
+	if(g_rxCallBackPtr != NULL_PTR)
+	{
+		(*g_rxCallBackPtr)(data);
+		return;
+	}
+	if(nextHead == g_rxTail)
+	{
+		/* Buffer is full, drop the new byte. */
+		g_rxOverflowCount++;
+		return;
+	}
+	g_rxBuffer[g_rxHead] = data;
+	g_rxHead = nextHead;
+}
+
+/*
+ * Description :
+ * Data register empty interrupt, moves the next byte from the TX ring buffer to UDR
+ * and disables itself when the buffer becomes empty.
+ */
+ISR( USART_UDRE_vect )
+{
+	if(g_txHead == g_txTail)
+	{
+		CLEAR_BIT(UCSRB,UDRIE);
+		return;
+	}
+	SET_BIT(UCSRA,TXC);
+	UDR = g_txBuffer[g_txTail];
+	g_txStarted = TRUE;
+	g_txTail = (g_txTail + 1) & (UART_TX_BUFFER_SIZE - 1);
+}
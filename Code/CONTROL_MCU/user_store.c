@@ -0,0 +1,278 @@
+ /******************************************************************************
+ *
+ * Module: USER STORE
+ *
+ * File Name: user_store.c
+ *
+ * Description: Source file for the users of the door saved in the external EEPROM.
+ *
+ * Author: Mohamed Khaled.
+ *
+ *******************************************************************************/
+
+#include "user_store.h"
+#include "external_eeprom.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/*
+ * Record: [state, password, reserved, CRC-8 of the previous bytes].
+ * An erased EEPROM reads 0xFF, so every state other than active or deleted is an empty slot.
+ * A deleted slot is reused by the next user but doesn't end the search like an empty one.
+ */
+#define USER_STATE_ACTIVE                 0xA5
+#define USER_STATE_DELETED                0x00
+#define USER_STATE_EMPTY                  0xFF
+#define USER_RECORD_PASSWORD              1
+#define USER_RECORD_CRC                   (USER_RECORD_SIZE - 1)
+
+#if (USER_RECORD_PASSWORD + PASSWORD_LENGTH > USER_RECORD_CRC)
+#error "The password doesn't fit in USER_RECORD_SIZE"
+#endif
+
+#if ((EEPROM_PAGE_SIZE % USER_RECORD_SIZE) != 0) || ((USER_TABLE_ADDRESS % USER_RECORD_SIZE) != 0)
+#error "A user record must not cross an EEPROM page"
+#endif
+
+/*******************************************************************************
+ *                               User Defined Types                            *
+ *******************************************************************************/
+/*
+ * Description:
+ * State of a slot read from EEPROM.
+ */
+typedef enum
+{
+	USER_RECORD_EMPTY, USER_RECORD_ACTIVE, USER_RECORD_DELETED, USER_RECORD_ERROR
+} USER_RecordState;
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+
+/* Data of the record under writing, kept till the transaction ends. */
+static uint8 g_record[USER_RECORD_SIZE];
+
+/* Longest distance of a user from the first slot of its password, the search ends after it. */
+static uint8 g_maxProbe = USER_MAX_COUNT - 1;
+
+/*******************************************************************************
+ *                      Functions Prototypes(Private)                          *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Returns the first slot checked for the password.
+ */
+static uint8 USER_hash(const uint8 *password);
+
+/*
+ * Description :
+ * Returns the CRC-8 (polynomial 0x07) of the record bytes before the CRC byte.
+ */
+static uint8 USER_calculateCrc(const uint8 *record);
+
+/*
+ * Description :
+ * Reads the record of the slot and returns its state, an active record with a wrong CRC is
+ * handled as deleted.
+ */
+static USER_RecordState USER_readRecord(uint8 slot, uint8 *record);
+
+/*
+ * Description :
+ * Returns the distance of the slot from the first slot checked for the password.
+ */
+static uint8 USER_getDistance(const uint8 *password, uint8 slot);
+
+/*
+ * Description :
+ * Returns the slot of the password or USER_SLOT_NONE, and the first slot that can hold it in freeSlot.
+ * The free slot is not searched if freeSlot is NULL_PTR.
+ */
+static uint8 USER_probe(const uint8 *password, uint8 *freeSlot);
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+uint8 USER_init(void)
+{
+	uint8 record[USER_RECORD_SIZE];
+	uint8 distance;
+
+	g_maxProbe = 0;
+	for(uint8 slot = 0; slot < USER_MAX_COUNT; slot++)
+	{
+		switch(USER_readRecord(slot, record))
+		{
+		case USER_RECORD_ACTIVE:
+			distance = USER_getDistance(&record[USER_RECORD_PASSWORD], slot);
+			if(distance > g_maxProbe)
+			{
+				g_maxProbe = distance;
+			}
+			break;
+		case USER_RECORD_ERROR:
+			g_maxProbe = USER_MAX_COUNT - 1;
+			return ERROR;
+		default:
+			break;
+		}
+	}
+	return SUCCESS;
+}
+
+uint8 USER_find(const uint8 *password)
+{
+	return USER_probe(password, NULL_PTR);
+}
+
+boolean USER_startAdd(const uint8 *password, TWI_Transaction *transaction, uint8 *slot)
+{
+	uint8 freeSlot;
+
+	*slot = USER_SLOT_NONE;
+	if((USER_probe(password, &freeSlot) != USER_SLOT_NONE) || (freeSlot == USER_SLOT_NONE))
+	{
+		return FALSE;
+	}
+	g_record[0] = USER_STATE_ACTIVE;
+	for(uint8 i = 0; i < PASSWORD_LENGTH; i++)
+	{
+		g_record[USER_RECORD_PASSWORD + i] = password[i];
+	}
+	for(uint8 i = USER_RECORD_PASSWORD + PASSWORD_LENGTH; i < USER_RECORD_CRC; i++)
+	{
+		g_record[i] = 0xFF;
+	}
+	g_record[USER_RECORD_CRC] = USER_calculateCrc(g_record);
+	/* The record is in one page, so it is written by one write cycle. */
+	EEPROM_startWrite(transaction, USER_TABLE_ADDRESS + (uint16)freeSlot * USER_RECORD_SIZE, g_record, USER_RECORD_SIZE);
+	*slot = freeSlot;
+	/* The limit is kept even if the write fails, a longer search is still right. */
+	if(USER_getDistance(password, freeSlot) > g_maxProbe)
+	{
+		g_maxProbe = USER_getDistance(password, freeSlot);
+	}
+	return TRUE;
+}
+
+boolean USER_startRemove(uint8 slot, TWI_Transaction *transaction)
+{
+	uint8 next[USER_RECORD_SIZE];
+
+	if((slot >= USER_MAX_COUNT) || (USER_readRecord(slot, g_record) != USER_RECORD_ACTIVE))
+	{
+		return FALSE;
+	}
+	/*
+	 * Only the state is changed, the slot keeps the search going to the users after it.
+	 * No search goes past an empty slot, so the slot before one is emptied too.
+	 */
+	g_record[0] = (USER_readRecord((slot + 1) % USER_MAX_COUNT, next) == USER_RECORD_EMPTY) ?
+			USER_STATE_EMPTY : USER_STATE_DELETED;
+	EEPROM_startWrite(transaction, USER_TABLE_ADDRESS + (uint16)slot * USER_RECORD_SIZE, g_record, 1);
+	return TRUE;
+}
+
+static uint8 USER_hash(const uint8 *password)
+{
+	/* FNV-1a with 16 bits, close passwords land on distant slots. */
+	uint16 hash = 0x9DC5;
+	for(uint8 i = 0; i < PASSWORD_LENGTH; i++)
+	{
+		hash = (hash ^ password[i]) * 0x0193;
+	}
+	return (uint8)((hash ^ (hash >> 8)) % USER_MAX_COUNT);
+}
+
+static uint8 USER_getDistance(const uint8 *password, uint8 slot)
+{
+	return (uint8)((slot + USER_MAX_COUNT - USER_hash(password)) % USER_MAX_COUNT);
+}
+
+static uint8 USER_calculateCrc(const uint8 *record)
+{
+	uint8 crc = 0xFF;
+	for(uint8 i = 0; i < USER_RECORD_CRC; i++)
+	{
+		crc ^= record[i];
+		for(uint8 bit = 0; bit < 8; bit++)
+		{
+			crc = (crc & 0x80) ? (uint8)((crc << 1) ^ 0x07) : (uint8)(crc << 1);
+		}
+	}
+	return crc;
+}
+
+static USER_RecordState USER_readRecord(uint8 slot, uint8 *record)
+{
+	if(EEPROM_readBlock(USER_TABLE_ADDRESS + (uint16)slot * USER_RECORD_SIZE, record, USER_RECORD_SIZE) == ERROR)
+	{
+		return USER_RECORD_ERROR;
+	}
+	switch(record[0])
+	{
+	case USER_STATE_ACTIVE:
+		return (USER_calculateCrc(record) == record[USER_RECORD_CRC]) ? USER_RECORD_ACTIVE : USER_RECORD_DELETED;
+	case USER_STATE_DELETED:
+		return USER_RECORD_DELETED;
+	default:
+		return USER_RECORD_EMPTY;
+	}
+}
+
+static uint8 USER_probe(const uint8 *password, uint8 *freeSlot)
+{
+	uint8 record[USER_RECORD_SIZE];
+	uint8 slot = USER_hash(password);
+	uint8 free = USER_SLOT_NONE;
+	uint8 i;
+	uint8 j;
+
+	if(freeSlot == NULL_PTR)
+	{
+		freeSlot = &free;
+	}
+	*freeSlot = USER_SLOT_NONE;
+	for(i = 0; i < USER_MAX_COUNT; i++)
+	{
+		/* No user is farther, so only the search of a free slot goes on. */
+		if((i > g_maxProbe) && ((freeSlot == &free) || (*freeSlot != USER_SLOT_NONE)))
+		{
+			return USER_SLOT_NONE;
+		}
+		switch(USER_readRecord(slot, record))
+		{
+		case USER_RECORD_ACTIVE:
+			for(j = 0; (j < PASSWORD_LENGTH) && (record[USER_RECORD_PASSWORD + j] == password[j]); j++);
+			if(j == PASSWORD_LENGTH)
+			{
+				return slot;
+			}
+			break;
+		case USER_RECORD_DELETED:
+			if(*freeSlot == USER_SLOT_NONE)
+			{
+				*freeSlot = slot;
+			}
+			break;
+		case USER_RECORD_EMPTY:
+			/* The password would have been saved here or before, so it is not in the table. */
+			if(*freeSlot == USER_SLOT_NONE)
+			{
+				*freeSlot = slot;
+			}
+			return USER_SLOT_NONE;
+		default:
+			/* The table can't be trusted without this record. */
+			*freeSlot = USER_SLOT_NONE;
+			return USER_SLOT_NONE;
+		}
+		slot = (slot + 1) % USER_MAX_COUNT;
+	}
+	return USER_SLOT_NONE;
+}
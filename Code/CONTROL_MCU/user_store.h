@@ -0,0 +1,75 @@
+ /******************************************************************************
+ *
+ * Module: USER STORE
+ *
+ * File Name: user_store.h
+ *
+ * Description: Header file for the users of the door saved in the external EEPROM.
+ *
+ * Author: Mohamed Khaled.
+ *
+ *******************************************************************************/
+
+#ifndef USER_STORE_H_
+#define USER_STORE_H_
+
+#include "std_types.h"
+#include "twi.h"
+#include "door_protocol.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/*
+ * Table of fixed size records in EEPROM, a record is found by hashing its password to a slot then
+ * checking the next slots till an empty one (open addressing), so a lookup usually reads one or two records.
+ * The search also ends after the longest distance of a user from its first slot, known from USER_init,
+ * so the deleted slots left by removed users don't make it read the whole table.
+ * The A8-A10 bits of the address select the EEPROM block, so the table spans blocks 1 to 4.
+ */
+#define USER_TABLE_ADDRESS                0x0100
+#define USER_MAX_COUNT                    128
+#define USER_RECORD_SIZE                  8
+
+/* Returned instead of a slot when the user is not found or the request failed. */
+#define USER_SLOT_NONE                    PROTOCOL_USER_NONE
+
+#if (USER_MAX_COUNT >= USER_SLOT_NONE)
+#error "USER_MAX_COUNT must be less than USER_SLOT_NONE"
+#endif
+
+/*******************************************************************************
+ *                      Functions Prototypes                                   *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Reads the table to find the longest distance of a user from its first slot, the searches are not
+ * limited till it is called. Returns ERROR if the EEPROM can't be read.
+ */
+uint8 USER_init(void);
+
+/*
+ * Description :
+ * Returns the slot of the user that has this password, or USER_SLOT_NONE.
+ */
+uint8 USER_find(const uint8 *password);
+
+/*
+ * Description :
+ * Starts writing a new user record by transaction and returns TRUE with its slot.
+ * Returns FALSE with USER_SLOT_NONE if the password is already used or the table is full.
+ * The transaction must stay valid till it ends, then the write cycle of the EEPROM starts.
+ */
+boolean USER_startAdd(const uint8 *password, TWI_Transaction *transaction, uint8 *slot);
+
+/*
+ * Description :
+ * Starts marking the user record as deleted by transaction and returns TRUE, it is marked as empty
+ * if the next slot is empty as it doesn't keep the search going to any user then.
+ * Returns FALSE if there is no user in the slot.
+ */
+boolean USER_startRemove(uint8 slot, TWI_Transaction *transaction);
+
+#endif /* USER_STORE_H_ */
@@ -0,0 +1,25 @@
+ /******************************************************************************
+ *
+ * Module: EEPROM EMULATOR
+ *
+ * File Name: interrupt.h
+ *
+ * Description: Host replacement of <avr/interrupt.h>, the interrupt flag is the I bit of the
+ *              emulated SREG and the TWI vector is called by the emulator.
+ *
+ * Author: Mohamed Khaled.
+ *
+ *******************************************************************************/
+
+#ifndef EMULATOR_AVR_INTERRUPT_H_
+#define EMULATOR_AVR_INTERRUPT_H_
+
+#include <avr/io.h>
+
+#define ISR(vector)       void vector(void)
+#define TWI_vect          EMU_twiVector
+
+#define cli()             (SREG &= (uint8_t)~(1 << SREG_I))
+#define sei()             (SREG |= (1 << SREG_I))
+
+#endif /* EMULATOR_AVR_INTERRUPT_H_ */
@@ -0,0 +1,49 @@
+ /******************************************************************************
+ *
+ * Module: EEPROM EMULATOR
+ *
+ * File Name: io.h
+ *
+ * Description: Host replacement of <avr/io.h> with the registers used by the TWI and EEPROM
+ *              drivers, they are variables updated by the emulator.
+ *
+ * Author: Mohamed Khaled.
+ *
+ *******************************************************************************/
+
+#ifndef EMULATOR_AVR_IO_H_
+#define EMULATOR_AVR_IO_H_
+
+#include <stdint.h>
+
+/*******************************************************************************
+ *                                Registers                                    *
+ *******************************************************************************/
+
+extern volatile uint8_t TWBR;
+extern volatile uint8_t TWSR;
+extern volatile uint8_t TWAR;
+extern volatile uint8_t TWCR;
+extern volatile uint8_t TWDR;
+extern volatile uint8_t SREG;
+extern volatile uint8_t PORTC;
+extern volatile uint8_t DDRC;
+extern volatile uint8_t PINC;
+
+/* TWCR bits. */
+#define TWINT 7
+#define TWEA  6
+#define TWSTA 5
+#define TWSTO 4
+#define TWWC  3
+#define TWEN  2
+#define TWIE  0
+
+/* TWSR bits. */
+#define TWPS1 1
+#define TWPS0 0
+
+/* SREG bits. */
+#define SREG_I 7
+
+#endif /* EMULATOR_AVR_IO_H_ */
@@ -0,0 +1,218 @@
+ /******************************************************************************
+ *
+ * Module: EEPROM EMULATOR
+ *
+ * File Name: benchmark.c
+ *
+ * Description: Runs the EEPROM operations of the control MCU on the emulator and reports the
+ *              bus time of each one and the wear of the EEPROM.
+ *              Usage: eeprom_emulator [-f image file] [-w write cycle in us]
+ *
+ * Author: Mohamed Khaled.
+ *
+ *******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <avr/interrupt.h>
+#include "emulator.h"
+#include "twi.h"
+#include "external_eeprom.h"
+#include "credential_store.h"
+#include "user_store.h"
+#include "audit_log.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/* The raw read and write tests use the first slots of the credential area, which are saved
+ * before them and written back after them. */
+#define RAW_TEST_AREA_ADDRESS             0x0000
+#define RAW_TEST_AREA_SIZE                0x0050
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+
+/* Statistics and time at the start of the measured operation. */
+static EMU_StatisticsType g_startStatistics;
+static uint64 g_startTime;
+
+/*******************************************************************************
+ *                      Private Functions Prototypes                           *
+ *******************************************************************************/
+
+/* Starts measuring an operation. */
+static void startOperation(void);
+/* Prints the bus activity since startOperation. */
+static void reportOperation(const char *name, boolean passed);
+/* Prints the write cycles and the most written cell. */
+static void reportWear(void);
+/* Writes the saved bytes of the raw test area back page by page. */
+static boolean restoreRawTestArea(const uint8 *saved);
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+int main(int argc, char *argv[])
+{
+	const char *file = "eeprom.bin";
+	uint32 writeCycleUs = EMU_DEFAULT_WRITE_CYCLE_US;
+	uint8 data[64];
+	uint8 saved[RAW_TEST_AREA_SIZE];
+	uint8 credentials[CREDENTIAL_DATA_SIZE] = {LOGIC_HIGH, 1, 2, 3, 4, 5};
+	TWI_Transaction transaction;
+	int option;
+
+	while((option = getopt(argc, argv, "f:w:")) != -1)
+	{
+		switch(option)
+		{
+		case 'f':
+			file = optarg;
+			break;
+		case 'w':
+			writeCycleUs = (uint32)strtoul(optarg, NULL_PTR, 10);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-f image file] [-w write cycle in us]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if(!EMU_init(file, writeCycleUs))
+	{
+		fprintf(stderr, "can't start the emulator\n");
+		return 1;
+	}
+	/* The TWI timeouts are counted by the 1 ms timer interrupt of the application. */
+	EMU_setTimerCallBack(TWI_timerTick);
+	sei();
+	EEPROM_init();
+
+	printf("%-34s %-6s %6s %10s %10s\n", "operation", "result", "bytes", "bus us", "total us");
+
+	if(EEPROM_readBlock(RAW_TEST_AREA_ADDRESS, saved, RAW_TEST_AREA_SIZE) != SUCCESS)
+	{
+		fprintf(stderr, "can't save the raw test area\n");
+		EMU_close();
+		return 1;
+	}
+
+	startOperation();
+	reportOperation("writeByte", EEPROM_writeByte(0x0010, 0x55) == SUCCESS);
+	startOperation();
+	reportOperation("waitReady after the write", EEPROM_waitReady() == SUCCESS);
+	startOperation();
+	reportOperation("readByte", (EEPROM_readByte(0x0010, data) == SUCCESS) && (data[0] == 0x55));
+
+	for(uint8 i = 0; i < sizeof(data); i++)
+	{
+		data[i] = i;
+	}
+	startOperation();
+	reportOperation("writeBlock 16 bytes, one page", EEPROM_writeBlock(0x0020, data, 16) == SUCCESS);
+	startOperation();
+	reportOperation("waitReady after the write", EEPROM_waitReady() == SUCCESS);
+	startOperation();
+	reportOperation("writeBlock 20 bytes, two pages", EEPROM_writeBlock(0x0038, data, 20) == SUCCESS);
+	startOperation();
+	reportOperation("waitReady after the write", EEPROM_waitReady() == SUCCESS);
+	startOperation();
+	reportOperation("readBlock 16 bytes", EEPROM_readBlock(0x0020, data, 16) == SUCCESS);
+	startOperation();
+	reportOperation("readBlock 64 bytes", EEPROM_readBlock(0x0000, data, 64) == SUCCESS);
+	startOperation();
+	reportOperation("isBusy on an idle EEPROM", !EEPROM_isBusy());
+
+	/* The saved records are loaded as they were before the raw tests. */
+	if(!restoreRawTestArea(saved))
+	{
+		fprintf(stderr, "can't restore the raw test area\n");
+		EMU_close();
+		return 1;
+	}
+
+	/* The saved password is changed as by the control MCU, the new record follows the newest one. */
+	startOperation();
+	reportOperation("CREDENTIAL_load, 16 slots", CREDENTIAL_load(data) == SUCCESS);
+	startOperation();
+	CREDENTIAL_startSave(credentials, &transaction);
+	reportOperation("CREDENTIAL_startSave", TWI_wait(&transaction) == TWI_DONE);
+	startOperation();
+	reportOperation("waitReady after the write", EEPROM_waitReady() == SUCCESS);
+	startOperation();
+	CREDENTIAL_startCommit(&transaction);
+	reportOperation("CREDENTIAL_startCommit", TWI_wait(&transaction) == TWI_DONE);
+	startOperation();
+	reportOperation("waitReady after the write", EEPROM_waitReady() == SUCCESS);
+	startOperation();
+	reportOperation("CREDENTIAL_load after the commit", (CREDENTIAL_load(data) == SUCCESS) && (data[0] == LOGIC_HIGH));
+	startOperation();
+	reportOperation("USER_init, 128 slots", USER_init() == SUCCESS);
+	startOperation();
+	reportOperation("USER_find", USER_find(&credentials[1]) == USER_SLOT_NONE);
+	startOperation();
+	reportOperation("AUDIT_init, 96 entries", AUDIT_init() == SUCCESS);
+
+	reportWear();
+	if(!EMU_close())
+	{
+		fprintf(stderr, "can't save %s\n", file);
+		return 1;
+	}
+	return 0;
+}
+
+static void startOperation(void)
+{
+	EMU_getStatistics(&g_startStatistics);
+	g_startTime = EMU_getTime();
+}
+
+static void reportOperation(const char *name, boolean passed)
+{
+	EMU_StatisticsType statistics;
+	uint64 time = EMU_getTime();
+
+	EMU_getStatistics(&statistics);
+	printf("%-34s %-6s %6lu %10.1f %10.1f\n", name, passed ? "ok" : "FAILED",
+			(unsigned long)(statistics.bytes - g_startStatistics.bytes),
+			(statistics.busTimeNs - g_startStatistics.busTimeNs) / 1000.0, (time - g_startTime) / 1000.0);
+}
+
+static void reportWear(void)
+{
+	EMU_StatisticsType statistics;
+	uint16 mostWritten = 0;
+
+	EMU_getStatistics(&statistics);
+	for(uint16 address = 1; address < EMU_EEPROM_SIZE; address++)
+	{
+		if(EMU_getWriteCount(address) > EMU_getWriteCount(mostWritten))
+		{
+			mostWritten = address;
+		}
+	}
+	printf("\ntransactions %lu, write cycles %lu, addresses not acknowledged while busy %lu\n",
+			(unsigned long)statistics.transactions, (unsigned long)statistics.writeCycles,
+			(unsigned long)statistics.busyNacks);
+	printf("most written cell 0x%03X: %lu writes in total\n", mostWritten,
+			(unsigned long)EMU_getWriteCount(mostWritten));
+}
+
+static boolean restoreRawTestArea(const uint8 *saved)
+{
+	for(uint8 offset = 0; offset < RAW_TEST_AREA_SIZE; offset += EEPROM_PAGE_SIZE)
+	{
+		if((EEPROM_writeBlock(RAW_TEST_AREA_ADDRESS + offset, &saved[offset], EEPROM_PAGE_SIZE) != SUCCESS)
+				|| (EEPROM_waitReady() != SUCCESS))
+		{
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
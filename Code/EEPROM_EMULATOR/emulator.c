@@ -0,0 +1,493 @@
+ /******************************************************************************
+ *
+ * Module: EEPROM EMULATOR
+ *
+ * File Name: emulator.c
+ *
+ * Description: Source file for the host model of the ATmega16 TWI module and a 24C16 EEPROM,
+ *              the TWI and EEPROM drivers of the control MCU run on it without changes.
+ *
+ * Author: Mohamed Khaled.
+ *
+ *******************************************************************************/
+
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <avr/io.h>
+#include "emulator.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/* TWSR values set by the model, as listed in the ATmega16 datasheet. */
+#define EMU_STATUS_BUS_ERROR              0x00
+#define EMU_STATUS_START                  0x08
+#define EMU_STATUS_REP_START              0x10
+#define EMU_STATUS_SLA_W_ACK              0x18
+#define EMU_STATUS_SLA_W_NACK             0x20
+#define EMU_STATUS_DATA_W_ACK             0x28
+#define EMU_STATUS_DATA_W_NACK            0x30
+#define EMU_STATUS_SLA_R_ACK              0x40
+#define EMU_STATUS_SLA_R_NACK             0x48
+#define EMU_STATUS_DATA_R_ACK             0x50
+#define EMU_STATUS_DATA_R_NACK            0x58
+
+/* SCL periods of the bus conditions, a byte takes 8 data clocks and the acknowledge clock. */
+#define EMU_CONDITION_CLOCKS              1
+#define EMU_BYTE_CLOCKS                   9
+
+#define EMU_NS_PER_MS                     1000000ULL
+
+/*******************************************************************************
+ *                               Types Declaration                             *
+ *******************************************************************************/
+
+/* State of the TWI module as a master. */
+typedef enum
+{
+	EMU_BUS_IDLE, EMU_BUS_ADDRESS, EMU_BUS_TRANSMIT, EMU_BUS_RECEIVE, EMU_BUS_NOT_SELECTED
+} EMU_BusStateType;
+
+/* State of the EEPROM in the current transfer. */
+typedef enum
+{
+	EMU_DEVICE_IDLE, EMU_DEVICE_WORD_ADDRESS, EMU_DEVICE_WRITE, EMU_DEVICE_READ
+} EMU_DeviceStateType;
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+
+/* Emulated registers. */
+volatile uint8_t TWBR = 0;
+volatile uint8_t TWSR = 0;
+volatile uint8_t TWAR = 0;
+volatile uint8_t TWCR = EMU_TWCR_HANDLED;
+volatile uint8_t TWDR = 0;
+volatile uint8_t SREG = 0;
+volatile uint8_t PORTC = 0;
+volatile uint8_t DDRC = 0;
+volatile uint8_t PINC = 0xFF;
+
+/* The TWI vector of the driver, defined by ISR(TWI_vect). */
+extern void EMU_twiVector(void);
+
+static const char *g_file = NULL_PTR;
+static uint32 g_writeCycleUs = EMU_DEFAULT_WRITE_CYCLE_US;
+static void (*volatile g_timerCallBack)(void) = NULL_PTR;
+
+static EMU_BusStateType g_busState = EMU_BUS_IDLE;
+static EMU_StatisticsType g_statistics;
+static uint64 g_time = 0;
+static uint64 g_nextTimerTick = EMU_NS_PER_MS;
+
+/* EEPROM content, write counters and the page latches filled by the current write. */
+static uint8 g_memory[EMU_EEPROM_SIZE];
+static uint32 g_writeCount[EMU_EEPROM_SIZE];
+static uint8 g_latch[EMU_EEPROM_PAGE_SIZE];
+static boolean g_latched[EMU_EEPROM_PAGE_SIZE];
+static EMU_DeviceStateType g_deviceState = EMU_DEVICE_IDLE;
+/* Address counter of the EEPROM and the block selected by the device address. */
+static uint16 g_pointer = 0;
+static uint8 g_block = 0;
+static uint64 g_busyUntil = 0;
+
+/*******************************************************************************
+ *                      Private Functions Prototypes                           *
+ *******************************************************************************/
+
+/* Called by the periodic signal, runs the TWI module, the EEPROM and the timer interrupt. */
+static void EMU_step(int signal);
+/* Executes the last value written to TWCR. */
+static void EMU_executeControl(uint8 control);
+/* Adds the time of SCL clocks at the bit rate set by TWBR and TWSR. */
+static void EMU_addBusClocks(uint8 clocks);
+/* Bus conditions and bytes seen by the EEPROM, the functions return TRUE if it acknowledges. */
+static void EMU_deviceStart(void);
+static void EMU_deviceStop(void);
+static boolean EMU_deviceAddress(uint8 address);
+static boolean EMU_deviceWrite(uint8 data);
+static uint8 EMU_deviceRead(void);
+/* Blocks or restores the periodic signal around the accesses of the main code to the model. */
+static void EMU_lock(sigset_t *old);
+static void EMU_unlock(const sigset_t *old);
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+boolean EMU_init(const char *file, uint32 writeCycleUs)
+{
+	struct sigaction action;
+	struct itimerval timer;
+	char wearFile[256];
+	FILE *stream;
+
+	g_file = file;
+	g_writeCycleUs = writeCycleUs;
+	memset(g_memory, 0xFF, sizeof(g_memory));
+	memset(g_writeCount, 0, sizeof(g_writeCount));
+	memset(&g_statistics, 0, sizeof(g_statistics));
+
+	stream = fopen(file, "rb");
+	if(stream != NULL_PTR)
+	{
+		if(fread(g_memory, 1, sizeof(g_memory), stream) != sizeof(g_memory))
+		{
+			fprintf(stderr, "%s: short EEPROM image, the rest is erased\n", file);
+		}
+		fclose(stream);
+	}
+	snprintf(wearFile, sizeof(wearFile), "%s.wear", file);
+	stream = fopen(wearFile, "rb");
+	if(stream != NULL_PTR)
+	{
+		if(fread(g_writeCount, sizeof(uint32), EMU_EEPROM_SIZE, stream) != EMU_EEPROM_SIZE)
+		{
+			memset(g_writeCount, 0, sizeof(g_writeCount));
+		}
+		fclose(stream);
+	}
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = EMU_step;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	if(sigaction(SIGALRM, &action, NULL_PTR) != 0)
+	{
+		return FALSE;
+	}
+	timer.it_interval.tv_sec = 0;
+	timer.it_interval.tv_usec = EMU_STEP_PERIOD_US;
+	timer.it_value = timer.it_interval;
+	return (setitimer(ITIMER_REAL, &timer, NULL_PTR) == 0);
+}
+
+boolean EMU_close(void)
+{
+	struct itimerval timer;
+	char wearFile[256];
+	FILE *stream;
+	boolean saved = TRUE;
+
+	memset(&timer, 0, sizeof(timer));
+	setitimer(ITIMER_REAL, &timer, NULL_PTR);
+	signal(SIGALRM, SIG_IGN);
+
+	stream = fopen(g_file, "wb");
+	if((stream == NULL_PTR) || (fwrite(g_memory, 1, sizeof(g_memory), stream) != sizeof(g_memory)))
+	{
+		saved = FALSE;
+	}
+	if(stream != NULL_PTR)
+	{
+		fclose(stream);
+	}
+	snprintf(wearFile, sizeof(wearFile), "%s.wear", g_file);
+	stream = fopen(wearFile, "wb");
+	if((stream == NULL_PTR) || (fwrite(g_writeCount, sizeof(uint32), EMU_EEPROM_SIZE, stream) != EMU_EEPROM_SIZE))
+	{
+		saved = FALSE;
+	}
+	if(stream != NULL_PTR)
+	{
+		fclose(stream);
+	}
+	return saved;
+}
+
+void EMU_setTimerCallBack(void (*callBack)(void))
+{
+	g_timerCallBack = callBack;
+}
+
+uint64 EMU_getTime(void)
+{
+	sigset_t old;
+	uint64 time;
+
+	EMU_lock(&old);
+	time = g_time;
+	EMU_unlock(&old);
+	return time;
+}
+
+void EMU_getStatistics(EMU_StatisticsType *statistics)
+{
+	sigset_t old;
+
+	EMU_lock(&old);
+	*statistics = g_statistics;
+	EMU_unlock(&old);
+}
+
+uint32 EMU_getWriteCount(uint16 address)
+{
+	sigset_t old;
+	uint32 count;
+
+	EMU_lock(&old);
+	count = g_writeCount[address % EMU_EEPROM_SIZE];
+	EMU_unlock(&old);
+	return count;
+}
+
+static void EMU_step(int signal)
+{
+	uint64 busTime = g_statistics.busTimeNs;
+
+	(void)signal;
+	for(;;)
+	{
+		if(!(TWCR & EMU_TWCR_HANDLED))
+		{
+			EMU_executeControl(TWCR);
+		}
+		else if((TWCR & (1 << TWINT)) && (TWCR & (1 << TWIE)) && (SREG & (1 << SREG_I)))
+		{
+			/* The interrupts are disabled during the ISR as on the MCU. */
+			SREG &= (uint8_t)~(1 << SREG_I);
+			EMU_twiVector();
+			SREG |= (1 << SREG_I);
+			if(TWCR & EMU_TWCR_HANDLED)
+			{
+				/* The ISR didn't clear TWINT, it is called again by the next step. */
+				break;
+			}
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	/* The bus time is the emulated time of the transfers, a step without transfers is idle time. */
+	if(g_statistics.busTimeNs == busTime)
+	{
+		g_time += EMU_STEP_PERIOD_US * 1000ULL;
+	}
+	while((g_time >= g_nextTimerTick) && (SREG & (1 << SREG_I)))
+	{
+		g_nextTimerTick += EMU_NS_PER_MS;
+		if(g_timerCallBack != NULL_PTR)
+		{
+			SREG &= (uint8_t)~(1 << SREG_I);
+			g_timerCallBack();
+			SREG |= (1 << SREG_I);
+		}
+	}
+}
+
+static void EMU_executeControl(uint8 control)
+{
+	uint8 status = EMU_STATUS_BUS_ERROR;
+
+	/* Disabling the module releases the bus, as done by the bus recovery of the driver. */
+	if(!(control & (1 << TWEN)))
+	{
+		if(g_busState != EMU_BUS_IDLE)
+		{
+			EMU_deviceStop();
+			g_busState = EMU_BUS_IDLE;
+		}
+		TWCR = control | EMU_TWCR_HANDLED;
+		return;
+	}
+	/* Only the enable bits are changed, writing one to TWINT starts the next action. */
+	if(!(control & (1 << TWINT)))
+	{
+		TWCR = control | EMU_TWCR_HANDLED;
+		return;
+	}
+
+	if(control & (1 << TWSTO))
+	{
+		EMU_addBusClocks(EMU_CONDITION_CLOCKS);
+		EMU_deviceStop();
+		g_busState = EMU_BUS_IDLE;
+		if(!(control & (1 << TWSTA)))
+		{
+			/* TWSTO is cleared when the STOP is sent, TWINT is not set. */
+			TWCR = (control & (uint8)~((1 << TWINT) | (1 << TWSTO))) | EMU_TWCR_HANDLED;
+			return;
+		}
+	}
+
+	if(control & (1 << TWSTA))
+	{
+		EMU_addBusClocks(EMU_CONDITION_CLOCKS);
+		if(g_busState == EMU_BUS_IDLE)
+		{
+			status = EMU_STATUS_START;
+			g_statistics.transactions++;
+		}
+		else
+		{
+			status = EMU_STATUS_REP_START;
+		}
+		EMU_deviceStart();
+		g_busState = EMU_BUS_ADDRESS;
+	}
+	else
+	{
+		switch(g_busState)
+		{
+		case EMU_BUS_ADDRESS:
+			EMU_addBusClocks(EMU_BYTE_CLOCKS);
+			g_statistics.bytes++;
+			if(TWDR & 0x01)
+			{
+				g_busState = EMU_deviceAddress(TWDR) ? EMU_BUS_RECEIVE : EMU_BUS_NOT_SELECTED;
+				status = (g_busState == EMU_BUS_RECEIVE) ? EMU_STATUS_SLA_R_ACK : EMU_STATUS_SLA_R_NACK;
+			}
+			else
+			{
+				g_busState = EMU_deviceAddress(TWDR) ? EMU_BUS_TRANSMIT : EMU_BUS_NOT_SELECTED;
+				status = (g_busState == EMU_BUS_TRANSMIT) ? EMU_STATUS_SLA_W_ACK : EMU_STATUS_SLA_W_NACK;
+			}
+			break;
+		case EMU_BUS_TRANSMIT:
+			EMU_addBusClocks(EMU_BYTE_CLOCKS);
+			g_statistics.bytes++;
+			status = EMU_deviceWrite(TWDR) ? EMU_STATUS_DATA_W_ACK : EMU_STATUS_DATA_W_NACK;
+			break;
+		case EMU_BUS_RECEIVE:
+			EMU_addBusClocks(EMU_BYTE_CLOCKS);
+			g_statistics.bytes++;
+			TWDR = EMU_deviceRead();
+			status = (control & (1 << TWEA)) ? EMU_STATUS_DATA_R_ACK : EMU_STATUS_DATA_R_NACK;
+			break;
+		case EMU_BUS_NOT_SELECTED:
+			/* Nobody acknowledges the bytes after a not acknowledged address. */
+			EMU_addBusClocks(EMU_BYTE_CLOCKS);
+			g_statistics.bytes++;
+			status = EMU_STATUS_DATA_W_NACK;
+			break;
+		default:
+			/* Data without START. */
+			break;
+		}
+	}
+
+	TWSR = status | (TWSR & ((1 << TWPS1) | (1 << TWPS0)));
+	TWCR = (control & (uint8)~(1 << TWSTO)) | (1 << TWINT) | EMU_TWCR_HANDLED;
+}
+
+static void EMU_addBusClocks(uint8 clocks)
+{
+	/* F_SCL = F_CPU / (16 + 2 * TWBR * 4 ^ TWPS) */
+	uint64 divider = 16 + 2ULL * TWBR * (1ULL << (2 * (TWSR & ((1 << TWPS1) | (1 << TWPS0)))));
+	uint64 time = clocks * divider * 1000000000ULL / F_CPU;
+
+	g_statistics.busTimeNs += time;
+	g_time += time;
+}
+
+static void EMU_deviceStart(void)
+{
+	/* A START before the STOP ends a write without programming it, as for the random read. */
+	g_deviceState = EMU_DEVICE_IDLE;
+	memset(g_latched, 0, sizeof(g_latched));
+}
+
+static void EMU_deviceStop(void)
+{
+	uint16 page = g_pointer & (uint16)~(EMU_EEPROM_PAGE_SIZE - 1);
+	boolean programmed = FALSE;
+
+	if(g_deviceState == EMU_DEVICE_WRITE)
+	{
+		/* The latched bytes of the page are programmed together by one write cycle. */
+		for(uint8 i = 0; i < EMU_EEPROM_PAGE_SIZE; i++)
+		{
+			if(g_latched[i])
+			{
+				g_memory[page + i] = g_latch[i];
+				g_writeCount[page + i]++;
+				programmed = TRUE;
+			}
+		}
+		if(programmed)
+		{
+			g_statistics.writeCycles++;
+			g_busyUntil = g_time + g_writeCycleUs * 1000ULL;
+		}
+	}
+	g_deviceState = EMU_DEVICE_IDLE;
+	memset(g_latched, 0, sizeof(g_latched));
+}
+
+static boolean EMU_deviceAddress(uint8 address)
+{
+	if((address & 0xF0) != EMU_EEPROM_DEVICE_ADDRESS)
+	{
+		return FALSE;
+	}
+	/* The inputs are disabled during the write cycle. */
+	if(g_time < g_busyUntil)
+	{
+		g_statistics.busyNacks++;
+		return FALSE;
+	}
+	/* A2..A0 of the device address are the address bits 10..8 of the 24C16. */
+	g_block = (address >> 1) & 0x07;
+	if(address & 0x01)
+	{
+		g_pointer = ((uint16)g_block << 8) | (g_pointer & 0xFF);
+		g_deviceState = EMU_DEVICE_READ;
+	}
+	else
+	{
+		g_deviceState = EMU_DEVICE_WORD_ADDRESS;
+	}
+	return TRUE;
+}
+
+static boolean EMU_deviceWrite(uint8 data)
+{
+	uint16 page;
+
+	switch(g_deviceState)
+	{
+	case EMU_DEVICE_WORD_ADDRESS:
+		g_pointer = ((uint16)g_block << 8) | data;
+		g_deviceState = EMU_DEVICE_WRITE;
+		return TRUE;
+	case EMU_DEVICE_WRITE:
+		/* The address counter rolls over inside the page, the bytes after the page end overwrite its start. */
+		page = g_pointer & (uint16)~(EMU_EEPROM_PAGE_SIZE - 1);
+		g_latch[g_pointer - page] = data;
+		g_latched[g_pointer - page] = TRUE;
+		g_pointer = page | ((g_pointer + 1) & (EMU_EEPROM_PAGE_SIZE - 1));
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+static uint8 EMU_deviceRead(void)
+{
+	uint8 data = g_memory[g_pointer];
+
+	/* The sequential read rolls over at the end of the memory. */
+	g_pointer = (g_pointer + 1) % EMU_EEPROM_SIZE;
+	return data;
+}
+
+static void EMU_lock(sigset_t *old)
+{
+	sigset_t set;
+
+	sigemptyset(&set);
+	sigaddset(&set, SIGALRM);
+	sigprocmask(SIG_BLOCK, &set, old);
+}
+
+static void EMU_unlock(const sigset_t *old)
+{
+	sigprocmask(SIG_SETMASK, old, NULL_PTR);
+}
@@ -0,0 +1,100 @@
+ /******************************************************************************
+ *
+ * Module: EEPROM EMULATOR
+ *
+ * File Name: emulator.h
+ *
+ * Description: Header file for the host model of the ATmega16 TWI module and a 24C16 EEPROM,
+ *              the TWI and EEPROM drivers of the control MCU run on it without changes.
+ *
+ * Author: Mohamed Khaled.
+ *
+ *******************************************************************************/
+
+#ifndef EMULATOR_H_
+#define EMULATOR_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/* 24C16: 2 KB in 8 blocks of 256 bytes selected by the device address, 16-byte pages. */
+#define EMU_EEPROM_SIZE                   2048
+#define EMU_EEPROM_PAGE_SIZE              16
+#define EMU_EEPROM_DEVICE_ADDRESS         0xA0
+/* Write cycle time (tWR) of the AT24C16 datasheet. */
+#define EMU_DEFAULT_WRITE_CYCLE_US        5000
+
+/*
+ * The model is run as the hardware by a periodic signal, like an interrupt it preempts the driver
+ * code and calls the TWI vector when the driver enables it. A period without bus activity is
+ * counted as idle time of this length.
+ */
+#define EMU_STEP_PERIOD_US                100
+
+/*
+ * TWCR bit 1 is reserved and never written by the drivers, the model sets it after handling a write
+ * to TWCR, so a new write is detected even if it writes the same value.
+ */
+#define EMU_TWCR_HANDLED                  0x02
+
+/*******************************************************************************
+ *                               Types Declaration                             *
+ *******************************************************************************/
+
+typedef struct
+{
+	uint32 transactions;			/* START conditions that are not repeated ones. */
+	uint32 bytes;					/* Address and data bytes on the bus. */
+	uint32 writeCycles;				/* Page writes programmed by the EEPROM. */
+	uint32 busyNacks;				/* Addresses not acknowledged during a write cycle. */
+	uint64 busTimeNs;				/* Time the bus is driven by the transfers. */
+} EMU_StatisticsType;
+
+/*******************************************************************************
+ *                      Functions Prototypes                                   *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Loads the EEPROM content and its write counters from the file, an erased EEPROM is used
+ * if the file doesn't exist, then starts the hardware model.
+ * Returns FALSE if the signal timer can't be started.
+ */
+boolean EMU_init(const char *file, uint32 writeCycleUs);
+
+/*
+ * Description :
+ * Stops the hardware model and saves the EEPROM content and its write counters to the file.
+ * Returns FALSE if the file can't be written.
+ */
+boolean EMU_close(void);
+
+/*
+ * Description :
+ * Sets the function called each 1 ms of emulated time while the interrupts are enabled,
+ * as the timer interrupt of the application.
+ */
+void EMU_setTimerCallBack(void (*callBack)(void));
+
+/*
+ * Description :
+ * Returns the emulated time in ns, the bus time of the transfers and the idle steps.
+ */
+uint64 EMU_getTime(void);
+
+/*
+ * Description :
+ * Copies the statistics counted since EMU_init.
+ */
+void EMU_getStatistics(EMU_StatisticsType *statistics);
+
+/*
+ * Description :
+ * Returns the number of times the EEPROM cell is programmed.
+ */
+uint32 EMU_getWriteCount(uint16 address);
+
+#endif /* EMULATOR_H_ */
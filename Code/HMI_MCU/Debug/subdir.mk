@@ -9,6 +9,11 @@ C_SRCS += \
 ../gpio.c \
 ../keypad.c \
 ../lcd.c \
+../link.c \
+../power.c \
+../request_queue.c \
+../scheduler.c \
+../sw_timer.c \
 ../timer.c \
 ../uart.c 
 
@@ -18,6 +23,11 @@ OBJS += \
 ./gpio.o \
 ./keypad.o \
 ./lcd.o \
+./link.o \
+./power.o \
+./request_queue.o \
+./scheduler.o \
+./sw_timer.o \
 ./timer.o \
 ./uart.o 
 
@@ -27,6 +37,11 @@ C_DEPS += \
 ./gpio.d \
 ./keypad.d \
 ./lcd.d \
+./link.d \
+./power.d \
+./request_queue.d \
+./scheduler.d \
+./sw_timer.d \
 ./timer.d \
 ./uart.d 
 
@@ -35,7 +50,7 @@ C_DEPS += \
 %.o: ../%.c subdir.mk
 	@echo 'Building file: $<'
 	@echo 'Invoking: AVR Compiler'
-	avr-gcc -Wall -g2 -gstabs -O0 -fpack-struct -fshort-enums -ffunction-sections -fdata-sections -std=gnu99 -funsigned-char -funsigned-bitfields -mmcu=atmega16 -DF_CPU=1000000UL -MMD -MP -MF"$(@:%.o=%.d)" -MT"$@" -c -o "$@" "$<"
+	avr-gcc -Wall -g2 -gstabs -O0 -fpack-struct -fshort-enums -ffunction-sections -fdata-sections -std=gnu99 -funsigned-char -funsigned-bitfields -mmcu=atmega16 -DF_CPU=8000000UL -MMD -MP -MF"$(@:%.o=%.d)" -MT"$@" -c -o "$@" "$<"
 	@echo 'Finished building: $<'
 	@echo ' '
 
@@ -16,6 +16,106 @@
 *                       Include common modules                         *
 ***********************************************************************/
 #include "std_types.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+
+/***********************************************************************
+*                              Definitions                             *
+***********************************************************************/
+#ifndef F_CPU
+#define F_CPU 8000000UL
+#endif
+
+/* CPU cycles of one pass of the delay loop, SBIW takes 2 cycles and a taken BRNE takes 2 cycles. */
+#define DELAY_LOOP_CYCLES                4UL
+
+/* Number of CPU cycles that last at least the given time, rounded up. */
+#define DELAY_US_TO_CYCLES(us)           (((uint32)(us) * ((F_CPU) / 1000UL) + 999UL) / 1000UL)
+#define DELAY_NS_TO_CYCLES(ns)           (((uint32)(ns) * ((F_CPU) / 1000UL) + 999999UL) / 1000000UL)
+
+
+/***********************************************************************
+*                              Macros                                  *
+***********************************************************************/
+/*
+ * Description:
+ * Busy loop of count passes of DELAY_LOOP_CYCLES cycles, a count of 0 makes 65536 passes.
+ */
+#define DELAY_LOOP(count) \
+	do \
+	{ \
+		uint16 delayLoopCount = (count); \
+		__asm__ __volatile__ ( \
+			"1: sbiw %0,1" "\n\t" \
+			"brne 1b" \
+			: "=w" (delayLoopCount) \
+			: "0" (delayLoopCount) \
+		); \
+	} while(0)
+
+/*
+ * Description:
+ * Busy waiting delay by the given number of CPU cycles, without any timer or interrupt.
+ * The number must be a constant, the loop counts are computed at compile time so the delay is exact
+ * to the cycle plus the loading of the count, even without optimization. The interrupts served
+ * during the delay make it longer, use the atomic variants when it must not be longer.
+ * It can be used in the ISRs.
+ */
+#define delay_cycles(cycles) \
+	do \
+	{ \
+		if(((cycles) / DELAY_LOOP_CYCLES) > 0xFFFFUL) \
+		{ \
+			for(uint16 delayRepeat = (uint16)(((cycles) / DELAY_LOOP_CYCLES) >> 16); delayRepeat != 0; delayRepeat--) \
+			{ \
+				DELAY_LOOP(0); \
+			} \
+		} \
+		if((((cycles) / DELAY_LOOP_CYCLES) & 0xFFFFUL) != 0UL) \
+		{ \
+			DELAY_LOOP((uint16)((cycles) / DELAY_LOOP_CYCLES)); \
+		} \
+		if(((cycles) % DELAY_LOOP_CYCLES) >= 2UL) \
+		{ \
+			__asm__ __volatile__ ("rjmp .+0"); \
+		} \
+		if(((cycles) % 2UL) != 0UL) \
+		{ \
+			__asm__ __volatile__ ("nop"); \
+		} \
+	} while(0)
+
+/*
+ * Description:
+ * Busy waiting delay by at least the given constant number of us or ns, based on F_CPU.
+ * They are meant for the short waits of the peripherals timing, the waits of ms are done by delay_ms.
+ */
+#define delay_us(us)                     delay_cycles(DELAY_US_TO_CYCLES(us))
+#define delay_ns(ns)                     delay_cycles(DELAY_NS_TO_CYCLES(ns))
+
+/*
+ * Description:
+ * The same delays with the interrupts disabled, so no interrupt makes them longer.
+ * SREG is restored after the delay, so they can be called from the ISRs and with the interrupts disabled.
+ */
+#define delay_usAtomic(us) \
+	do \
+	{ \
+		uint8 delaySreg = SREG; \
+		cli(); \
+		delay_us(us); \
+		SREG = delaySreg; \
+	} while(0)
+
+#define delay_nsAtomic(ns) \
+	do \
+	{ \
+		uint8 delaySreg = SREG; \
+		cli(); \
+		delay_ns(ns); \
+		SREG = delaySreg; \
+	} while(0)
 
 
 /***********************************************************************
@@ -23,8 +123,9 @@
 ***********************************************************************/
 /*
  * Description:
- * Make busy waiting delay by n ms.
- * This function uses Timer 1 in compare match mode.
+ * Make busy waiting delay by n ms, n must be less than 4294967 (about 71 minutes).
+ * This function uses the system tick of Timer 1, see TIMER_startSystemTick, so it waits for the
+ * tick interrupt and must not be called from the ISRs or with the interrupts disabled.
  */
 void delay_ms( uint32 n );
 
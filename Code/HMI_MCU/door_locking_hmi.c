@@ -16,43 +16,159 @@
 #define F_CPU 8000000
 
 #include <avr/io.h>
-#include "delay.h"
 #include "lcd.h"
 #include "gpio.h"
 #include "keypad.h"
+#include "timer.h"
+#include "sw_timer.h"
+#include "scheduler.h"
+#include "power.h"
 #include "uart.h"
+#include "link.h"
+#include "request_queue.h"
+#include "door_protocol.h"
+
+/* Address of the door controller selected after boot, another door can be selected by '*' key. */
+#define HMI_DEFAULT_DOOR_ADDRESS						 0x01
+/* Number of door controllers that can be selected on the multi-drop bus. */
+#define HMI_MAX_DOOR_ADDRESS							 9
+
+/* Baud rate requested from control MCU after boot, rejected at compile time if F_CPU can't generate it. */
+#define HMI_FAST_BAUD_RATE								 250000UL
+
+#if !UART_BAUD_RATE_IS_VALID(HMI_FAST_BAUD_RATE)
+#error "HMI_FAST_BAUD_RATE error exceeds UART_MAX_BAUD_ERROR at this F_CPU"
+#endif
+
+/* Buffers for the frames received by the UART RX ISR, one of them is always under reception. */
+#define HMI_FRAME_POOL_SIZE								 3
+
+/* Events of the scheduler by priority, the responses are handled first. */
+#define HMI_EVENT_LINK									 0
+#define HMI_EVENT_KEYPAD								 1
+#define HMI_EVENT_TIMEOUT								 2
+
+/* Period of the request deadlines, retransmissions and heartbeat checks. */
+#define HMI_LINK_POLL_PERIOD_MS							 10
+/*
+ * Period of the keypad scan, longer than the bouncing of the keys.
+ * The keypad port has no external interrupt, so the scan timer wakes the CPU to find a pressed key.
+ */
+#define HMI_KEYPAD_SCAN_PERIOD_MS						 20
+/*
+ * Time added to the door cycle before the HMI stops following it, the events are not repeated,
+ * so the main screen is displayed after this time if the DOOR_STATE_CLOSED event is lost.
+ */
+#define HMI_DOOR_EVENTS_MARGIN_MS						 1000
+/* Time of the messages and errors on LCD. */
+#define HMI_MESSAGE_TIME_MS								 1000
+/* Time given to control MCUs to switch to the new baud rate, a software timer may end up to 1 ms early. */
+#define HMI_BAUD_SWITCH_DELAY_MS						 3
+/* Wrong passwords that turn the buzzer on. */
+#define HMI_MAX_TRIALS									 3
+/* Code of the enter key of the keypad. */
+#define HMI_ENTER_KEY									 13
 
-/* This messages are used for MCUs hand shaking. */
-#define CONTROL_MCU_READY 								 0x10
-#define HMI_MCU_READY									 0xff
-
-/* Commands that can be handled by control MCU. */
-#define CONTROL_COMPARE_TWO_PASSWORDS					 0x01
-#define CONTROL_CHECK_PASSWORD_LENGTH  					 0x02
-#define CONTROL_CHECK_SAVED_PASSWORD_FLAG 				 0x03
-#define CONTROL_ERASE_SAVED_PASSWORD					 0x04
-#define CHECK_PASSWORD_WITH_SAVED_PASSWORD				 0x05
-#define CONTROL_MOTOR_ROTATE_CW							 0x06
-#define CONTROL_MOTOR_STOP 								 0x07
-#define CONTROL_MOTOR_ROTATE_CCW						 0x08
-#define CONTROL_BUZZER_ON 								 0X09
-#define CONTROL_BUZZER_OFF								 0X0A
-
-#define COMPARE_RESULT_TRUE 0x01
-#define COMPARE_RESULT_FALSE 0x00
-#define PASSWORD_LENGTH								   	5
 
 /***********************************************************************
  *                          User Defined Types                         *
  ***********************************************************************/
 /* All types of errors that may occur in the application.*/
 typedef enum {
-	PASSWORD_LENGTH_ERROR, PASSWORD_REENTERING_ERROR, PASSWORD_INCORRECT, PASSWORD_INCORRECT_THREE_TIMES
+	PASSWORD_LENGTH_ERROR, PASSWORD_REENTERING_ERROR, PASSWORD_INCORRECT, PASSWORD_INCORRECT_THREE_TIMES,
+	LINK_ERROR
 } Error;
 
+/* What the application waits for, each event is handled according to it. */
+typedef enum {
+	HMI_STATE_BOOT, HMI_STATE_SETUP, HMI_STATE_NEW_PASSWORD, HMI_STATE_REENTER_PASSWORD, HMI_STATE_PASSWORD,
+	HMI_STATE_LENGTH_CHECK, HMI_STATE_COMPARE, HMI_STATE_VERIFY, HMI_STATE_MESSAGE, HMI_STATE_MENU,
+	HMI_STATE_SELECT_DOOR, HMI_STATE_DOOR_EVENTS, HMI_STATE_DOOR_TIMED
+} HmiState;
+
+/* Why the password is entered. */
+typedef enum {
+	HMI_PURPOSE_SETUP, HMI_PURPOSE_UNLOCK, HMI_PURPOSE_CHANGE
+} HmiPurpose;
+
+/* Steps of the baud rate negotiation. */
+typedef enum {
+	HMI_NEGOTIATION_IDLE, HMI_NEGOTIATION_SWITCHING, HMI_NEGOTIATION_CONFIRMING
+} HmiNegotiation;
+
 /***********************************************************************
  *                         Functions Prototypes                        *
  ***********************************************************************/
+/*
+ * Description:
+ * Handler of HMI_EVENT_LINK, handles the received frames, the request deadlines and the heartbeat,
+ * then the responses of the application requests and the door events.
+ * Goes back to the boot baud rate when the link is lost and negotiates the fast rate again
+ * when the controller answers.
+ */
+void serviceLink( void );
+/*
+ * Description:
+ * Handler of HMI_EVENT_KEYPAD, scans the keypad and handles a new key press.
+ */
+void scanKeypad( void );
+/*
+ * Description:
+ * Handler of HMI_EVENT_TIMEOUT, ends the displayed message, moves the door cycle to the next step
+ * or stops following the door cycle whose events are lost.
+ */
+void handleTimeout( void );
+/*
+ * Description:
+ * Called by the UART RX ISR when a frame is received, posts HMI_EVENT_LINK.
+ */
+void frameReceived( void );
+/*
+ * Description:
+ * Callback of the link poll timer, posts HMI_EVENT_LINK.
+ */
+void pollTimerExpired( void );
+/*
+ * Description:
+ * Callback of the baud rate negotiation timer, posts HMI_EVENT_LINK.
+ */
+void linkTimerExpired( void );
+/*
+ * Description:
+ * Callback of the keypad timer, posts HMI_EVENT_KEYPAD.
+ */
+void keypadTimerExpired( void );
+/*
+ * Description:
+ * Callback of the application timer, posts HMI_EVENT_TIMEOUT.
+ */
+void uiTimerExpired( void );
+/*
+ * Description:
+ * Idle handler of the scheduler, sleeps until the next event.
+ */
+void enterIdle( void );
+/*
+ * Description:
+ * Handles a key pressed in the current state.
+ */
+void handleKey( uint8 key );
+/*
+ * Description:
+ * Handles the response of the application request in the current state, a failed request
+ * shows LINK_ERROR and the step is done again.
+ */
+void handleResponse( const LINK_FrameType* response );
+/*
+ * Description:
+ * Follows the door cycle events sent by control MCU on LCD till the door is closed.
+ */
+void handleDoorEvent( const LINK_FrameType* event );
+/*
+ * Description:
+ * Starts to ask the user for a password, the state selects the prompt and the buffer.
+ */
+void beginEntry( HmiState state );
 /*
  * Description:
  * Asks the user to enter new password.
@@ -60,14 +176,39 @@ typedef enum {
 void requestNewPassword( void );
 /*
  * Description:
- * Displays different types of errors in the system.
+ * Displays requesting password screen on LCD.
+ */
+void requestPassword( void );
+/*
+ * Description:
+ * Asks again for the password whose length is wrong.
  */
-void displayError (Error error);
+void restartEntry( void );
 /*
  * Description:
- * Sends commands to control MCU to compare the entered two passwords.
+ * Displays different types of errors in the system, then calls next.
  */
-uint8 checkNewPassword( void );
+void displayError( Error error, void (*next)(void) );
+/*
+ * Description:
+ * Displays PASSWORD_REENTERING_ERROR, then asks for a new password.
+ */
+void displayReenteringError( void );
+/*
+ * Description:
+ * Keeps the LCD content for HMI_MESSAGE_TIME_MS, then clears it and calls next.
+ */
+void showMessage( void (*next)(void) );
+/*
+ * Description:
+ * Sends the entered password and the re-entered one to control MCU to compare them and save the password.
+ */
+void checkNewPassword( void );
+/*
+ * Description:
+ * Displays the result of the passwords comparison and continues by the main screen or a new password.
+ */
+void newPasswordCompared( uint8 result );
 /*
  * Description:
  * Displays main screen on LCD.
@@ -75,26 +216,132 @@ uint8 checkNewPassword( void );
 void displayMainOptions( void );
 /*
  * Description:
- * Displays requesting password screen on LCD.
+ * Checks length of password locally if the controller allows it, otherwise by sending
+ * "CONTROL_CHECK_PASSWORD_LENGTH" to controlling MCU.
  */
-void requestPassword( void );
+void checkPasswordLength( uint8 length );
+/*
+ * Description:
+ * Continues the password entry after its length is checked.
+ */
+void passwordLengthChecked( uint8 result );
+/*
+ * Description:
+ * Sends "CONTROL_VERIFY_AND_CYCLE_DOOR" with the entered password to control MCU to open the door,
+ * or checks the password by "CHECK_PASSWORD_WITH_SAVED_PASSWORD".
+ */
+void verifyPassword( void );
 /*
  * Description:
- * Checks length of password by sending "CONTROL_CHECK_PASSWORD_LENGTH" to controlling MCU and then
- * sending the password.
+ * Opens the door or asks for the new password if the password is correct, otherwise asks again
+ * and turns the buzzer on after HMI_MAX_TRIALS wrong passwords.
  */
-uint8 checkPasswordLength(uint8 length);
+void passwordVerified( uint8 result );
 /*
  * Description:
- * Checks entered password with saved password on EEPROM by sending "CHECK_PASSWORD_WITH_SAVED_PASSWORD" to control MCU and then
- * sending the password.
+ * Turns the buzzer off after the thief warning and asks for the password again.
  */
-uint8 checkTryingPassword( void );
+void stopAlarm( void );
 /*
  * Description:
- * Requests password from user and displays '*' in LCD instead of real characters.
+ * Displays the door cycle run by control MCU, it is followed by its events till it is closed
+ * or till the time of the cycle passes.
  */
-void getPassword( uint8* pass, uint8* counter );
+void displayDoorCycle( void );
+/*
+ * Description:
+ * Runs the door cycle by motor commands for the controllers without CONTROL_VERIFY_AND_CYCLE_DOOR.
+ */
+void runDoorCycle( void );
+/*
+ * Description:
+ * Moves the door cycle run by motor commands to its next step.
+ */
+void runDoorCycleStep( void );
+/*
+ * Description:
+ * Sends one request frame to control MCU, its response is handled by handleResponse.
+ * If the request queue is full, the request is sent again by the next HMI_EVENT_LINK.
+ */
+void sendCommand( uint8 command, const uint8* payload, uint8 length );
+/*
+ * Description:
+ * Returns the first result byte of the response, or 0 if the request has no result or failed.
+ */
+uint8 getResult( const LINK_FrameType* response );
+/*
+ * Description:
+ * Requests HMI_FAST_BAUD_RATE from all control MCUs, then switches to it after HMI_BAUD_SWITCH_DELAY_MS.
+ */
+void negotiateBaudRate( void );
+/*
+ * Description:
+ * Runs the next step of the baud rate negotiation, the rate is confirmed by CONTROL_PING and the
+ * boot baud rate is used again if the selected door doesn't answer in time.
+ */
+void continueNegotiation( void );
+/*
+ * Description:
+ * Sends CONTROL_HELLO to the selected door controller, its capabilities are saved from the response.
+ * No capability is assumed if the controller doesn't know the command or doesn't answer.
+ */
+void helloControl( void );
+/*
+ * Description:
+ * Asks the selected door controller for a saved password and requests a new one if there is none.
+ */
+void setupDoor( void );
+/*
+ * Description:
+ * Asks the user for the number of the door controller to be used by the next requests.
+ */
+void selectDoor( void );
+
+/* Address of the door controller that receives the requests. */
+uint8 g_targetDoor = HMI_DEFAULT_DOOR_ADDRESS;
+/* Received frames, assembled in place by the link receiver. */
+LINK_FrameType g_framePool[HMI_FRAME_POOL_SIZE];
+/* Set while the link is down and the UART is at the boot baud rate. */
+boolean g_linkLost = FALSE;
+/* PROTOCOL_CAP_XXX bits reported by the selected door controller. */
+uint8 g_doorCapabilities = 0;
+
+/* Current state of the application, the state whose password is entered and why. */
+HmiState g_state = HMI_STATE_BOOT;
+HmiState g_entryState = HMI_STATE_PASSWORD;
+HmiPurpose g_purpose = HMI_PURPOSE_SETUP;
+/* Number of the entered keys of the password. */
+uint8 g_entryLength = 0;
+/* Wrong passwords entered one after the other. */
+uint8 g_trials = 0;
+/* TRUE if the door cycle is run by control MCU after CONTROL_VERIFY_AND_CYCLE_DOOR. */
+boolean g_cycleByControl = FALSE;
+/* Current step of the door cycle run by motor commands. */
+uint8 g_doorStep = DOOR_STATE_CLOSED;
+/* Called when the displayed message ends. */
+void (*g_messageDone)(void) = NULL_PTR;
+/* Set while a key is held, so a key is handled once for each press. */
+boolean g_keyHeld = FALSE;
+
+/* Requests waiting for their responses: the application request, CONTROL_HELLO and the baud rate confirmation. */
+uint8 g_commandRequest = REQUEST_NO_HANDLE;
+uint8 g_helloRequest = REQUEST_NO_HANDLE;
+uint8 g_pingRequest = REQUEST_NO_HANDLE;
+/* Requests dropped while the request queue was full, they are sent again by the next HMI_EVENT_LINK. */
+boolean g_commandDropped = FALSE;
+boolean g_helloDropped = FALSE;
+uint8 g_droppedCommand = 0;
+uint8 g_droppedLength = 0;
+uint8 g_droppedPayload[LINK_MAX_PAYLOAD_LENGTH];
+HmiNegotiation g_negotiation = HMI_NEGOTIATION_IDLE;
+/* Set by the negotiation timer callback. */
+volatile boolean g_linkTimerExpired = FALSE;
+
+/* Software timers of the link poll, the keypad scan, the baud rate negotiation and the application. */
+SWTIMER_Handle g_pollTimer = SWTIMER_INVALID_HANDLE;
+SWTIMER_Handle g_keypadTimer = SWTIMER_INVALID_HANDLE;
+SWTIMER_Handle g_linkTimer = SWTIMER_INVALID_HANDLE;
+SWTIMER_Handle g_uiTimer = SWTIMER_INVALID_HANDLE;
 
 uint8 password[PASSWORD_LENGTH];
 uint8 reEnteredPassword[PASSWORD_LENGTH];
@@ -108,117 +355,441 @@ int main ( void )
 {
 	/* Enable global interrupt. */
 	SREG |= (1<<7);
-	UART_ConfigType config = {9600,BITS_8,NO_PARITY,ONE_STOP_BIT};
+	/* 9-bit data for the multi-processor communication mode of the shared bus. */
+	UART_ConfigType config = {PROTOCOL_BOOT_BAUD_RATE,BITS_9,NO_PARITY,ONE_STOP_BIT,UART_INTERRUPT_MODE};
 	UART_init(&config);
+	LINK_init(LINK_MASTER_ADDRESS);
+	LINK_setFramePool(g_framePool, HMI_FRAME_POOL_SIZE);
+	REQUEST_init();
+	REQUEST_setHeartbeatAddress(g_targetDoor);
 	LCD_init();
-	/*************************** UNCOMMENT the next two lines to make hard reset and set new password ***************************/
+
 	/*
-	while(UART_recieveByte() != CONTROL_MCU_READY);
-	UART_sendByte(CONTROL_ERASE_SAVED_PASSWORD);
-	*/
-	while(UART_recieveByte() != CONTROL_MCU_READY);
-	UART_sendByte(CONTROL_CHECK_SAVED_PASSWORD_FLAG);
-	UART_sendByte(HMI_MCU_READY);
-	uint8 flag = UART_recieveByte();
-	/* If there is no saved password, get one.*/
-	if(flag == LOGIC_LOW)
-	{
-		do
+	 * The waits are done by the software timers on the system tick of timer 1, which counts the
+	 * 1 ms time of the link deadlines and heartbeat too, so the CPU sleeps between the events.
+	 */
+	SWTIMER_init();
+	SWTIMER_setTickCallBack(LINK_timerTick);
+	POWER_init();
+	g_pollTimer = SWTIMER_create(pollTimerExpired);
+	g_keypadTimer = SWTIMER_create(keypadTimerExpired);
+	g_linkTimer = SWTIMER_create(linkTimerExpired);
+	g_uiTimer = SWTIMER_create(uiTimerExpired);
+
+	/*
+	 * Each handler runs to completion and never waits, the requests are answered by events,
+	 * so a response or a key is delayed by one handler at most.
+	 */
+	SCHEDULER_init();
+	SCHEDULER_setHandler(HMI_EVENT_LINK, serviceLink);
+	SCHEDULER_setHandler(HMI_EVENT_KEYPAD, scanKeypad);
+	SCHEDULER_setHandler(HMI_EVENT_TIMEOUT, handleTimeout);
+	SCHEDULER_setIdleHandler(enterIdle);
+	LINK_setFrameCallBack(frameReceived);
+	SWTIMER_start(g_pollTimer, HMI_LINK_POLL_PERIOD_MS, HMI_LINK_POLL_PERIOD_MS);
+	SWTIMER_start(g_keypadTimer, HMI_KEYPAD_SCAN_PERIOD_MS, HMI_KEYPAD_SCAN_PERIOD_MS);
+	/* The door is set up when the negotiation ends. */
+	negotiateBaudRate();
+	SCHEDULER_run();
+
+	return 0;
+}
+
+
+/*
+ * Description:
+ * Handler of HMI_EVENT_LINK, handles the received frames, the request deadlines and the heartbeat,
+ * then the responses of the application requests and the door events.
+ * Goes back to the boot baud rate when the link is lost and negotiates the fast rate again
+ * when the controller answers.
+ */
+void serviceLink( void )
+{
+	LINK_FrameType frame;
+
+	REQUEST_poll();
+	if(g_helloDropped)
+	{
+		helloControl();
+	}
+	if(g_commandDropped)
+	{
+		sendCommand(g_droppedCommand, g_droppedPayload, g_droppedLength);
+	}
+	if(g_negotiation != HMI_NEGOTIATION_IDLE)
+	{
+		continueNegotiation();
+	}
+	else
+	{
+		LINK_StateType state = LINK_getState();
+		if((state == LINK_DOWN) && !g_linkLost)
 		{
-			requestNewPassword();
-		}while(	checkNewPassword() == LOGIC_LOW);
-		delay_ms(1000);
+			/* The silent controller goes back to the boot rate by itself after the same timeout. */
+			g_linkLost = TRUE;
+			UART_flush();
+			UART_setBaudRate(PROTOCOL_BOOT_BAUD_RATE);
+			LINK_resync();
+			/* Stop following the cycle if the controller stops answering the heartbeat. */
+			if(g_state == HMI_STATE_DOOR_EVENTS)
+			{
+				LCD_clearScreen();
+				displayMainOptions();
+			}
+		}
+		else if((state == LINK_UP) && g_linkLost)
+		{
+			g_linkLost = FALSE;
+			negotiateBaudRate();
+		}
+	}
+
+	if((g_helloRequest != REQUEST_NO_HANDLE) && REQUEST_isComplete(g_helloRequest))
+	{
+		REQUEST_wait(g_helloRequest, &frame);
+		g_helloRequest = REQUEST_NO_HANDLE;
+		if((frame.payload[0] == PROTOCOL_STATUS_OK) && (frame.length >= 3))
+		{
+			g_doorCapabilities = frame.payload[2];
+		}
+		if(g_state == HMI_STATE_SETUP)
+		{
+			sendCommand(CONTROL_CHECK_SAVED_PASSWORD_FLAG, NULL_PTR, 0);
+		}
+	}
+	if((g_commandRequest != REQUEST_NO_HANDLE) && REQUEST_isComplete(g_commandRequest))
+	{
+		REQUEST_wait(g_commandRequest, &frame);
+		g_commandRequest = REQUEST_NO_HANDLE;
+		handleResponse(&frame);
+	}
+	while(REQUEST_getEvent(&frame))
+	{
+		handleDoorEvent(&frame);
+	}
+}
+
+
+/*
+ * Description:
+ * Handler of HMI_EVENT_KEYPAD, scans the keypad and handles a new key press.
+ */
+void scanKeypad( void )
+{
+	uint8 key;
+
+	if(!KEYPAD_tryGetPressedKey(&key))
+	{
+		g_keyHeld = FALSE;
+		return;
+	}
+	if(!g_keyHeld)
+	{
+		g_keyHeld = TRUE;
+		handleKey(key);
 	}
+}
+
 
-	while(1)
+/*
+ * Description:
+ * Handler of HMI_EVENT_TIMEOUT, ends the displayed message, moves the door cycle to the next step
+ * or stops following the door cycle whose events are lost.
+ */
+void handleTimeout( void )
+{
+	if(g_state == HMI_STATE_MESSAGE)
+	{
+		LCD_clearScreen();
+		(*g_messageDone)();
+	}
+	else if(g_state == HMI_STATE_DOOR_TIMED)
+	{
+		runDoorCycleStep();
+	}
+	else if(g_state == HMI_STATE_DOOR_EVENTS)
 	{
+		/* The door is closed by now even if its events are lost. */
+		LCD_clearScreen();
 		displayMainOptions();
 	}
+}
 
-	return 0;
+
+/*
+ * Description:
+ * Called by the UART RX ISR when a frame is received, posts HMI_EVENT_LINK.
+ */
+void frameReceived( void )
+{
+	SCHEDULER_post(HMI_EVENT_LINK);
 }
 
 
 /*
  * Description:
- * Requests password from user and displays '*' in LCD instead of real characters.
+ * Callback of the link poll timer, posts HMI_EVENT_LINK.
  */
-void getPassword( uint8* pass, uint8* counter )
+void pollTimerExpired( void )
 {
-	uint8 key;
+	SCHEDULER_post(HMI_EVENT_LINK);
+}
 
-	LCD_moveCursor(1, 0);
-	*counter = 0;
 
-	while(1)
+/*
+ * Description:
+ * Callback of the baud rate negotiation timer, posts HMI_EVENT_LINK.
+ */
+void linkTimerExpired( void )
+{
+	g_linkTimerExpired = TRUE;
+	SCHEDULER_post(HMI_EVENT_LINK);
+}
+
+
+/*
+ * Description:
+ * Callback of the keypad timer, posts HMI_EVENT_KEYPAD.
+ */
+void keypadTimerExpired( void )
+{
+	SCHEDULER_post(HMI_EVENT_KEYPAD);
+}
+
+
+/*
+ * Description:
+ * Callback of the application timer, posts HMI_EVENT_TIMEOUT.
+ */
+void uiTimerExpired( void )
+{
+	SCHEDULER_post(HMI_EVENT_TIMEOUT);
+}
+
+
+/*
+ * Description:
+ * Idle handler of the scheduler, sleeps until the next event.
+ */
+void enterIdle( void )
+{
+	POWER_idle(TIMER_MAX_SYSTEM_TICK_MS);
+}
+
+
+/*
+ * Description:
+ * Handles a key pressed in the current state.
+ */
+void handleKey( uint8 key )
+{
+	uint8* pass;
+
+	switch(g_state)
 	{
-		key = KEYPAD_getPressedKey();
-		pass[*counter] = key;
+	case HMI_STATE_NEW_PASSWORD:
+	case HMI_STATE_REENTER_PASSWORD:
+	case HMI_STATE_PASSWORD:
 		/*If user press enter -> end of edit.*/
-		if(key == 13)
+		if(key == HMI_ENTER_KEY)
 		{
-			delay_ms(400);
+			g_entryState = g_state;
+			checkPasswordLength(g_entryLength);
 			break;
 		}
+		pass = (g_state == HMI_STATE_NEW_PASSWORD) ? password :
+				((g_state == HMI_STATE_REENTER_PASSWORD) ? reEnteredPassword : tryingPassword);
+		/* The extra keys are only counted, so a long password is rejected by its length. */
+		if(g_entryLength < PASSWORD_LENGTH)
+		{
+			pass[g_entryLength] = key;
+		}
+		if(g_entryLength < 0xFF)
+		{
+			g_entryLength++;
+		}
 		LCD_displayCharacter('*');
-		delay_ms(400);
-		(*counter)++;
+		break;
+	case HMI_STATE_MENU:
+		if(key == '+')
+		{
+			g_purpose = HMI_PURPOSE_UNLOCK;
+			g_trials = 0;
+			requestPassword();
+		}
+		else if(key == '-')
+		{
+			g_purpose = HMI_PURPOSE_CHANGE;
+			g_trials = 0;
+			requestPassword();
+		}
+		else if(key == '*')
+		{
+			selectDoor();
+		}
+		break;
+	case HMI_STATE_SELECT_DOOR:
+		if((key != 0) && (key <= HMI_MAX_DOOR_ADDRESS))
+		{
+			g_targetDoor = key;
+			REQUEST_setHeartbeatAddress(g_targetDoor);
+			setupDoor();
+		}
+		break;
+	default:
+		/* The keys pressed while waiting for control MCU or a message are ignored. */
+		break;
 	}
 }
 
 
 /*
  * Description:
- * Asks the user to enter new password.
+ * Handles the response of the application request in the current state, a failed request
+ * shows LINK_ERROR and the step is done again.
  */
-void requestNewPassword( void )
+void handleResponse( const LINK_FrameType* response )
 {
-	uint8 passLength;
-	boolean errorFlag = LOGIC_HIGH;
-	LCD_clearScreen();
-	/* Enter password till pressing enter */
-	while(errorFlag == LOGIC_HIGH)
+	uint8 result = getResult(response);
+
+	/* A failed request says nothing about the password, so it is not counted as a wrong one. */
+	if((response->payload[0] != PROTOCOL_STATUS_OK) || (response->length < 2))
 	{
-		errorFlag = LOGIC_LOW;
-		/* Request new password from user and then press Enter key*/
-		LCD_displayString("Enter new pass.:");
-		getPassword(password, &passLength);
-		uint8 result = checkPasswordLength( passLength );
+		switch(g_state)
+		{
+		case HMI_STATE_SETUP:
+		case HMI_STATE_COMPARE:
+			/* The new password may be saved or not, the saved password flag is asked again. */
+			displayError(LINK_ERROR, setupDoor);
+			break;
+		case HMI_STATE_LENGTH_CHECK:
+		case HMI_STATE_VERIFY:
+			displayError(LINK_ERROR, restartEntry);
+			break;
+		default:
+			break;
+		}
+		return;
+	}
+
+	switch(g_state)
+	{
+	case HMI_STATE_SETUP:
+		/* If there is no saved password, get one.*/
 		if(result == LOGIC_LOW)
 		{
-			errorFlag = LOGIC_HIGH;
-			Error error = PASSWORD_LENGTH_ERROR;
-			displayError(error);
+			g_purpose = HMI_PURPOSE_SETUP;
+			requestNewPassword();
 		}
+		else
+		{
+			displayMainOptions();
+		}
+		break;
+	case HMI_STATE_LENGTH_CHECK:
+		passwordLengthChecked(result);
+		break;
+	case HMI_STATE_COMPARE:
+		newPasswordCompared(result);
+		break;
+	case HMI_STATE_VERIFY:
+		passwordVerified(result);
+		break;
+	default:
+		break;
 	}
+}
 
-	LCD_clearScreen();
 
-	errorFlag = LOGIC_HIGH;
-	/* Enter password till pressing enter */
-	while(errorFlag == LOGIC_HIGH)
+/*
+ * Description:
+ * Follows the door cycle events sent by control MCU on LCD till the door is closed.
+ */
+void handleDoorEvent( const LINK_FrameType* event )
+{
+	if((g_state != HMI_STATE_DOOR_EVENTS) || (event->command != CONTROL_DOOR_EVENT) ||
+			(event->address != g_targetDoor) || (event->length != 1))
 	{
-		errorFlag = LOGIC_LOW;
-		LCD_displayString("Re-enter pass.:");
-		getPassword(reEnteredPassword, &passLength);
+		return;
+	}
+	switch(event->payload[0])
+	{
+	case DOOR_STATE_HOLDING:
+		LCD_clearScreen();
+		break;
+	case DOOR_STATE_CLOSING:
+		LCD_clearScreen();
+		LCD_displayString("Closing");
+		break;
+	case DOOR_STATE_CLOSED:
+		SWTIMER_stop(g_uiTimer);
+		LCD_clearScreen();
+		displayMainOptions();
+		break;
+	}
+}
 
-		uint8 result = checkPasswordLength( passLength );
 
-		if(result == LOGIC_LOW)
-		{
-			errorFlag = LOGIC_HIGH;
-			Error error = PASSWORD_LENGTH_ERROR;
-			displayError(error);
-		}
+/*
+ * Description:
+ * Starts to ask the user for a password, the state selects the prompt and the buffer.
+ */
+void beginEntry( HmiState state )
+{
+	LCD_clearScreen();
+	switch(state)
+	{
+	case HMI_STATE_NEW_PASSWORD:
+		LCD_displayString("Enter new pass.:");
+		break;
+	case HMI_STATE_REENTER_PASSWORD:
+		LCD_displayString("Re-enter pass.:");
+		break;
+	default:
+		LCD_displayString("Enter pass.:");
+		break;
 	}
+	LCD_moveCursor(1, 0);
+	g_entryLength = 0;
+	g_state = state;
+}
+
+
+/*
+ * Description:
+ * Asks the user to enter new password.
+ */
+void requestNewPassword( void )
+{
+	beginEntry(HMI_STATE_NEW_PASSWORD);
+}
+
+
+/*
+ * Description:
+ * Displays requesting password screen on LCD.
+ */
+void requestPassword( void )
+{
+	beginEntry(HMI_STATE_PASSWORD);
 }
 
 
 /*
  * Description:
- * Displays different types of errors in the system.
+ * Asks again for the password whose length is wrong.
  */
-void displayError( Error error )
+void restartEntry( void )
+{
+	beginEntry(g_entryState);
+}
+
+
+/*
+ * Description:
+ * Displays different types of errors in the system, then calls next.
+ */
+void displayError( Error error, void (*next)(void) )
 {
 	switch(error)
 	{
@@ -228,8 +799,6 @@ void displayError( Error error )
 		LCD_displayString("Password must be");
 		LCD_moveCursor(1, 0);
 		LCD_displayString("5 characters");
-		delay_ms(1000);
-		LCD_clearScreen();
 		break;
 	case PASSWORD_REENTERING_ERROR:
 		LCD_clearScreen();
@@ -237,8 +806,6 @@ void displayError( Error error )
 		LCD_displayString("Error");
 		LCD_moveCursor(1, 3);
 		LCD_displayString("Try Again");
-		delay_ms(1000);
-		LCD_clearScreen();
 		break;
 	case PASSWORD_INCORRECT:
 		LCD_clearScreen();
@@ -246,8 +813,6 @@ void displayError( Error error )
 		LCD_displayString("Error");
 		LCD_moveCursor(1, 0);
 		LCD_displayString("Incorrect Pass.");
-		delay_ms(1000);
-		LCD_clearScreen();
 		break;
 	case PASSWORD_INCORRECT_THREE_TIMES:
 		LCD_clearScreen();
@@ -255,53 +820,83 @@ void displayError( Error error )
 		LCD_displayString("Warning");
 		LCD_moveCursor(1, 5);
 		LCD_displayString("Thief");
-		delay_ms(1000);
+		break;
+	case LINK_ERROR:
 		LCD_clearScreen();
+		LCD_moveCursor(0, 4);
+		LCD_displayString("Door not");
+		LCD_moveCursor(1, 3);
+		LCD_displayString("responding");
 		break;
 	}
+	showMessage(next);
 }
 
 
 /*
  * Description:
- * Sends commands to control MCU to compare the entered two passwords.
+ * Displays PASSWORD_REENTERING_ERROR, then asks for a new password.
  */
-uint8 checkNewPassword( void )
+void displayReenteringError( void )
 {
-	/* Sending checking password command to control MCU after getting acknoledgement.*/
-	while(UART_recieveByte() != CONTROL_MCU_READY);
-	UART_sendByte(CONTROL_COMPARE_TWO_PASSWORDS);
+	displayError(PASSWORD_REENTERING_ERROR, requestNewPassword);
+}
 
-	while(UART_recieveByte() != CONTROL_MCU_READY);
-	/* Sending password */
-	for (uint8 i = 0; i < PASSWORD_LENGTH; i++)
-	{
-		UART_sendByte(password[i]);
-	}
-	/* Sending reentered password */
+
+/*
+ * Description:
+ * Keeps the LCD content for HMI_MESSAGE_TIME_MS, then clears it and calls next.
+ */
+void showMessage( void (*next)(void) )
+{
+	g_messageDone = next;
+	g_state = HMI_STATE_MESSAGE;
+	SWTIMER_start(g_uiTimer, HMI_MESSAGE_TIME_MS, 0);
+}
+
+
+/*
+ * Description:
+ * Sends the entered password and the re-entered one to control MCU to compare them and save the password.
+ */
+void checkNewPassword( void )
+{
+	uint8 passwords[2 * PASSWORD_LENGTH];
+	/* The request carries the password followed by the re-entered password. */
 	for (uint8 i = 0; i < PASSWORD_LENGTH; i++)
 	{
-		UART_sendByte(reEnteredPassword[i]);
+		passwords[i] = password[i];
+		passwords[PASSWORD_LENGTH + i] = reEnteredPassword[i];
 	}
+	g_state = HMI_STATE_COMPARE;
+	sendCommand(CONTROL_COMPARE_TWO_PASSWORDS, passwords, 2 * PASSWORD_LENGTH);
+}
+
 
-	UART_sendByte(HMI_MCU_READY);
-	uint8 compareResult = UART_recieveByte();
-	if(compareResult)
+/*
+ * Description:
+ * Displays the result of the passwords comparison and continues by the main screen or a new password.
+ */
+void newPasswordCompared( uint8 result )
+{
+	if(result)
 	{
 		LCD_clearScreen();
 		LCD_moveCursor(0, 6);
 		LCD_displayString("Match");
+		showMessage(displayMainOptions);
 	}
 	else
 	{
 		LCD_clearScreen();
 		LCD_moveCursor(0, 4);
 		LCD_displayString("Mis Match");
+		/* The user is told to try again only when the password is changed. */
+		showMessage((g_purpose == HMI_PURPOSE_CHANGE) ? displayReenteringError : requestNewPassword);
 	}
-	delay_ms(1000);
-	return compareResult;
 }
 
+
 /*
  * Description:
  * Displays main screen on LCD.
@@ -312,81 +907,174 @@ void displayMainOptions( void )
 	LCD_displayString("+ : Open Door.");
 	LCD_moveCursor(1, 0);
 	LCD_displayString("- : Change Pass.");
-	uint8 key = KEYPAD_getPressedKey();
-	delay_ms(400);
-	uint8 trials = 0;
-	switch(key)
-	{
-	case '+':
-		trials = 0;
-		requestPassword();
-		Error error;
-		while(!checkTryingPassword())
+	g_state = HMI_STATE_MENU;
+}
+
+
+/*
+ * Description:
+ * Checks length of password locally if the controller allows it, otherwise by sending
+ * "CONTROL_CHECK_PASSWORD_LENGTH" to controlling MCU.
+ */
+void checkPasswordLength( uint8 length )
+{
+	if(g_doorCapabilities & PROTOCOL_CAP_LOCAL_LENGTH_CHECK)
+	{
+		passwordLengthChecked(length == PASSWORD_LENGTH);
+		return;
+	}
+	g_state = HMI_STATE_LENGTH_CHECK;
+	sendCommand(CONTROL_CHECK_PASSWORD_LENGTH, &length, 1);
+}
+
+
+/*
+ * Description:
+ * Continues the password entry after its length is checked.
+ */
+void passwordLengthChecked( uint8 result )
+{
+	/* Display error if password is not 5 characters. */
+	if(result == LOGIC_LOW)
+	{
+		displayError(PASSWORD_LENGTH_ERROR, restartEntry);
+		return;
+	}
+	switch(g_entryState)
+	{
+	case HMI_STATE_NEW_PASSWORD:
+		beginEntry(HMI_STATE_REENTER_PASSWORD);
+		break;
+	case HMI_STATE_REENTER_PASSWORD:
+		checkNewPassword();
+		break;
+	default:
+		verifyPassword();
+		break;
+	}
+}
+
+
+/*
+ * Description:
+ * Sends "CONTROL_VERIFY_AND_CYCLE_DOOR" with the entered password to control MCU to open the door,
+ * or checks the password by "CHECK_PASSWORD_WITH_SAVED_PASSWORD".
+ */
+void verifyPassword( void )
+{
+	/* Control MCU verifies the password and runs the whole door cycle by itself if it can. */
+	g_cycleByControl = (g_purpose == HMI_PURPOSE_UNLOCK) &&
+			(g_doorCapabilities & PROTOCOL_CAP_VERIFY_AND_CYCLE);
+	g_state = HMI_STATE_VERIFY;
+	sendCommand(g_cycleByControl ? CONTROL_VERIFY_AND_CYCLE_DOOR : CHECK_PASSWORD_WITH_SAVED_PASSWORD,
+			tryingPassword, PASSWORD_LENGTH);
+}
+
+
+/*
+ * Description:
+ * Opens the door or asks for the new password if the password is correct, otherwise asks again
+ * and turns the buzzer on after HMI_MAX_TRIALS wrong passwords.
+ */
+void passwordVerified( uint8 result )
+{
+	if(result)
+	{
+		if(g_purpose == HMI_PURPOSE_CHANGE)
 		{
-			error = PASSWORD_INCORRECT;
-			displayError(error);
-			requestPassword();
-			trials++;
-			if(trials >= 3)
-			{
-				/* This is a thief. */
-				while(UART_recieveByte() != CONTROL_MCU_READY);
-				UART_sendByte(CONTROL_BUZZER_ON);
-				error = PASSWORD_INCORRECT_THREE_TIMES;
-				displayError(error);
-				while(UART_recieveByte() != CONTROL_MCU_READY);
-				UART_sendByte(CONTROL_BUZZER_OFF);
-				trials = 0;
-			}
+			requestNewPassword();
 		}
-		LCD_clearScreen();
-		LCD_displayString("Openning");
-		while(UART_recieveByte() != CONTROL_MCU_READY);
-		UART_sendByte(CONTROL_MOTOR_ROTATE_CW);
-		delay_ms(1000);
-		LCD_clearScreen();
-		while(UART_recieveByte() != CONTROL_MCU_READY);
-		UART_sendByte(CONTROL_MOTOR_STOP);
-		delay_ms(500);
-		LCD_displayString("Closing");
-		UART_sendByte(CONTROL_MOTOR_ROTATE_CCW);
-		while(UART_recieveByte() != CONTROL_MCU_READY);
-		delay_ms(1000);
-		LCD_clearScreen();
-		while(UART_recieveByte() != CONTROL_MCU_READY);
-		UART_sendByte(CONTROL_MOTOR_STOP);
-		break;
-	case '-':
-		trials = 0;
-		requestPassword();
-		while(!checkTryingPassword())
+		else if(g_cycleByControl)
 		{
-			error = PASSWORD_INCORRECT;
-			displayError(error);
-			requestPassword();
-			trials++;
-			if(trials >= 3)
-			{
-				/* This is a thief. */
-				while(UART_recieveByte() != CONTROL_MCU_READY);
-				UART_sendByte(CONTROL_BUZZER_ON);
-				error = PASSWORD_INCORRECT_THREE_TIMES;
-				displayError(error);
-				while(UART_recieveByte() != CONTROL_MCU_READY);
-				UART_sendByte(CONTROL_BUZZER_OFF);
-				trials = 0;
-			}
+			displayDoorCycle();
 		}
-		requestNewPassword();
-		while(!checkNewPassword())
+		else
 		{
-			Error error = PASSWORD_REENTERING_ERROR;
-			displayError(error);
-			requestNewPassword();
-
+			runDoorCycle();
 		}
+		return;
+	}
+	g_trials++;
+	if(g_trials >= HMI_MAX_TRIALS)
+	{
+		/* This is a thief. */
+		g_trials = 0;
+		REQUEST_post(g_targetDoor, CONTROL_BUZZER_ON, NULL_PTR, 0);
+		displayError(PASSWORD_INCORRECT_THREE_TIMES, stopAlarm);
+	}
+	else
+	{
+		displayError(PASSWORD_INCORRECT, requestPassword);
+	}
+}
+
+
+/*
+ * Description:
+ * Turns the buzzer off after the thief warning and asks for the password again.
+ */
+void stopAlarm( void )
+{
+	REQUEST_post(g_targetDoor, CONTROL_BUZZER_OFF, NULL_PTR, 0);
+	requestPassword();
+}
+
+
+/*
+ * Description:
+ * Displays the door cycle run by control MCU, it is followed by its events till it is closed
+ * or till the time of the cycle passes.
+ */
+void displayDoorCycle( void )
+{
+	LCD_clearScreen();
+	LCD_displayString("Openning");
+	g_state = HMI_STATE_DOOR_EVENTS;
+	SWTIMER_start(g_uiTimer, DOOR_OPENING_TIME_MS + DOOR_HOLDING_TIME_MS + DOOR_CLOSING_TIME_MS +
+			HMI_DOOR_EVENTS_MARGIN_MS, 0);
+}
+
+
+/*
+ * Description:
+ * Runs the door cycle by motor commands for the controllers without CONTROL_VERIFY_AND_CYCLE_DOOR.
+ */
+void runDoorCycle( void )
+{
+	LCD_clearScreen();
+	LCD_displayString("Openning");
+	REQUEST_post(g_targetDoor, CONTROL_MOTOR_ROTATE_CW, NULL_PTR, 0);
+	g_doorStep = DOOR_STATE_OPENING;
+	g_state = HMI_STATE_DOOR_TIMED;
+	SWTIMER_start(g_uiTimer, DOOR_OPENING_TIME_MS, 0);
+}
+
+
+/*
+ * Description:
+ * Moves the door cycle run by motor commands to its next step.
+ */
+void runDoorCycleStep( void )
+{
+	switch(g_doorStep)
+	{
+	case DOOR_STATE_OPENING:
+		REQUEST_post(g_targetDoor, CONTROL_MOTOR_STOP, NULL_PTR, 0);
+		LCD_clearScreen();
+		g_doorStep = DOOR_STATE_HOLDING;
+		SWTIMER_start(g_uiTimer, DOOR_HOLDING_TIME_MS, 0);
+		break;
+	case DOOR_STATE_HOLDING:
+		LCD_displayString("Closing");
+		REQUEST_post(g_targetDoor, CONTROL_MOTOR_ROTATE_CCW, NULL_PTR, 0);
+		g_doorStep = DOOR_STATE_CLOSING;
+		SWTIMER_start(g_uiTimer, DOOR_CLOSING_TIME_MS, 0);
 		break;
 	default:
+		REQUEST_post(g_targetDoor, CONTROL_MOTOR_STOP, NULL_PTR, 0);
+		LCD_clearScreen();
+		g_doorStep = DOOR_STATE_CLOSED;
+		displayMainOptions();
 		break;
 	}
 }
@@ -394,27 +1082,25 @@ void displayMainOptions( void )
 
 /*
  * Description:
- * Displays requesting password screen on LCD.
+ * Sends one request frame to control MCU, its response is handled by handleResponse.
+ * If the request queue is full, the request is sent again by the next HMI_EVENT_LINK.
  */
-void requestPassword( void )
+void sendCommand( uint8 command, const uint8* payload, uint8 length )
 {
-	uint8 passLength;
-	boolean errorFlag = LOGIC_HIGH;
-	LCD_clearScreen();
-	/* Enter password till pressing enter */
-	while(errorFlag == LOGIC_HIGH)
+	/* A late response of a dropped request is not handled. */
+	if(g_commandRequest != REQUEST_NO_HANDLE)
 	{
-		errorFlag = LOGIC_LOW;
-		/* Request password from user and then press Enter key*/
-		LCD_displayString("Enter pass.:");
-		getPassword(tryingPassword, &passLength);
-		uint8 result = checkPasswordLength( passLength );
-
-		if(result == LOGIC_LOW)
+		REQUEST_cancel(g_commandRequest);
+	}
+	g_commandRequest = REQUEST_send(g_targetDoor, command, payload, length);
+	g_commandDropped = (g_commandRequest == REQUEST_NO_HANDLE);
+	if(g_commandDropped)
+	{
+		g_droppedCommand = command;
+		g_droppedLength = length;
+		for (uint8 i = 0; i < length; i++)
 		{
-			errorFlag = LOGIC_HIGH;
-			Error error = PASSWORD_LENGTH_ERROR;
-			displayError(error);
+			g_droppedPayload[i] = payload[i];
 		}
 	}
 }
@@ -422,40 +1108,141 @@ void requestPassword( void )
 
 /*
  * Description:
- * Checks length of password by sending "CONTROL_CHECK_PASSWORD_LENGTH" to controlling MCU and then
- * sending the password.
+ * Returns the first result byte of the response, or 0 if the request has no result or failed.
  */
-uint8 checkPasswordLength(uint8 length)
+uint8 getResult( const LINK_FrameType* response )
 {
-	/* Display error if password is not 5 characters. */
-	while(UART_recieveByte() != CONTROL_MCU_READY);
-	UART_sendByte(CONTROL_CHECK_PASSWORD_LENGTH);
+	if((response->payload[0] != PROTOCOL_STATUS_OK) || (response->length < 2))
+	{
+		return 0;
+	}
+	return response->payload[1];
+}
+
+
+/*
+ * Description:
+ * Requests HMI_FAST_BAUD_RATE from all control MCUs, then switches to it after HMI_BAUD_SWITCH_DELAY_MS.
+ */
+void negotiateBaudRate( void )
+{
+	uint8 baudRate[4];
 
-	while(UART_recieveByte() != CONTROL_MCU_READY);
-	UART_sendByte(length);
+	/* All the controllers on the bus must use the same rate, so the request is broadcast and not answered. */
+	baudRate[0] = (uint8)(HMI_FAST_BAUD_RATE >> 24);
+	baudRate[1] = (uint8)(HMI_FAST_BAUD_RATE >> 16);
+	baudRate[2] = (uint8)(HMI_FAST_BAUD_RATE >> 8);
+	baudRate[3] = (uint8)HMI_FAST_BAUD_RATE;
+	REQUEST_post(LINK_BROADCAST_ADDRESS, CONTROL_SET_BAUD_RATE, baudRate, 4);
+	UART_flush();
 
-	UART_sendByte(HMI_MCU_READY);
-	return UART_recieveByte();
+	/* Give control MCUs the time to switch, then confirm the rate to all of them. */
+	g_linkTimerExpired = FALSE;
+	g_negotiation = HMI_NEGOTIATION_SWITCHING;
+	SWTIMER_start(g_linkTimer, HMI_BAUD_SWITCH_DELAY_MS, 0);
 }
 
 
 /*
  * Description:
- * Checks entered password with saved password on EEPROM by sending "CHECK_PASSWORD_WITH_SAVED_PASSWORD" to control MCU and then
- * sending the password.
+ * Runs the next step of the baud rate negotiation, the rate is confirmed by CONTROL_PING and the
+ * boot baud rate is used again if the selected door doesn't answer in time.
  */
-uint8 checkTryingPassword( void )
+void continueNegotiation( void )
 {
-	while(UART_recieveByte() != CONTROL_MCU_READY);
-	UART_sendByte(CHECK_PASSWORD_WITH_SAVED_PASSWORD);
+	boolean expired = g_linkTimerExpired;
 
-	while(UART_recieveByte() != CONTROL_MCU_READY);
-	/* Sending password */
-	for (uint8 i = 0; i < PASSWORD_LENGTH; i++)
+	if(g_negotiation == HMI_NEGOTIATION_SWITCHING)
+	{
+		if(!expired)
+		{
+			return;
+		}
+		g_linkTimerExpired = FALSE;
+		UART_setBaudRate(HMI_FAST_BAUD_RATE);
+		REQUEST_post(LINK_BROADCAST_ADDRESS, CONTROL_PING, NULL_PTR, 0);
+		g_pingRequest = REQUEST_send(g_targetDoor, CONTROL_PING, NULL_PTR, 0);
+		g_negotiation = HMI_NEGOTIATION_CONFIRMING;
+		SWTIMER_start(g_linkTimer, PROTOCOL_BAUD_CONFIRM_TIMEOUT_MS, 0);
+		return;
+	}
+
+	/* A late response is dropped by the request queue. */
+	if(REQUEST_isComplete(g_pingRequest))
+	{
+		SWTIMER_stop(g_linkTimer);
+		g_linkTimerExpired = FALSE;
+	}
+	else if(expired)
+	{
+		g_linkTimerExpired = FALSE;
+		/* Older control firmware ignores the request and stays at the boot rate. */
+		UART_flush();
+		UART_setBaudRate(PROTOCOL_BOOT_BAUD_RATE);
+	}
+	else
 	{
-		UART_sendByte(tryingPassword[i]);
+		return;
 	}
+	REQUEST_cancel(g_pingRequest);
+	g_pingRequest = REQUEST_NO_HANDLE;
+	g_negotiation = HMI_NEGOTIATION_IDLE;
 
-	UART_sendByte(HMI_MCU_READY);
-	return UART_recieveByte();
+	if(g_state == HMI_STATE_BOOT)
+	{
+		setupDoor();
+	}
+	else
+	{
+		/* The controller may have been reset with another firmware. */
+		helloControl();
+	}
+}
+
+
+/*
+ * Description:
+ * Sends CONTROL_HELLO to the selected door controller, its capabilities are saved from the response.
+ * No capability is assumed if the controller doesn't know the command or doesn't answer.
+ */
+void helloControl( void )
+{
+	uint8 version = PROTOCOL_VERSION;
+
+	if(g_helloRequest != REQUEST_NO_HANDLE)
+	{
+		REQUEST_cancel(g_helloRequest);
+	}
+	g_doorCapabilities = 0;
+	g_helloRequest = REQUEST_send(g_targetDoor, CONTROL_HELLO, &version, 1);
+	g_helloDropped = (g_helloRequest == REQUEST_NO_HANDLE);
+}
+
+
+/*
+ * Description:
+ * Asks the selected door controller for a saved password and requests a new one if there is none.
+ * The saved password flag is requested when the CONTROL_HELLO response arrives.
+ */
+void setupDoor( void )
+{
+	/*************************** UNCOMMENT the next line to make hard reset and set new password ***************************/
+	/*
+	REQUEST_post(g_targetDoor, CONTROL_ERASE_SAVED_PASSWORD, NULL_PTR, 0);
+	*/
+	g_state = HMI_STATE_SETUP;
+	helloControl();
+}
+
+
+/*
+ * Description:
+ * Asks the user for the number of the door controller to be used by the next requests.
+ */
+void selectDoor( void )
+{
+	LCD_clearScreen();
+	LCD_displayString("Door number:");
+	LCD_moveCursor(1, 0);
+	g_state = HMI_STATE_SELECT_DOOR;
 }
@@ -43,4 +43,10 @@
  */
 uint8 KEYPAD_getPressedKey(void);
 
+/*
+ * Description :
+ * Scan the keypad once, returns TRUE and stores the pressed button in key if one is pressed.
+ */
+boolean KEYPAD_tryGetPressedKey(uint8 *key);
+
 #endif /* KEYPAD_H_ */
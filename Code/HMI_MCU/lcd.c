@@ -23,7 +23,8 @@
  * Description :
  * Initialize the LCD:
  * 1. Setup the LCD pins directions by use the GPIO driver.
- * 2. Setup the LCD Data Mode 4-bits or 8-bits.
+ * 2. Wait for the power on reset of the LCD.
+ * 3. Setup the LCD Data Mode 4-bits or 8-bits.
  */
 void LCD_init(void)
 {
@@ -32,6 +33,9 @@ void LCD_init(void)
 	GPIO_setupPinDirection(LCD_RW_PORT_ID,LCD_RW_PIN_ID,PIN_OUTPUT);
 	GPIO_setupPinDirection(LCD_E_PORT_ID,LCD_E_PIN_ID,PIN_OUTPUT);
 
+	/* The LCD ignores the commands till its power on reset ends */
+	delay_ms(LCD_POWER_ON_TIME_MS);
+
 #if (LCD_DATA_BITS_MODE == 4)
 
 	/* Configure 4 pins in the data port as output pins */
@@ -62,9 +66,9 @@ void LCD_sendCommand(uint8 command)
 	uint8 lcd_port_value = 0;
 	GPIO_writePin(LCD_RS_PORT_ID,LCD_RS_PIN_ID,LOGIC_LOW); /* Instruction Mode RS=0 */
 	GPIO_writePin(LCD_RW_PORT_ID,LCD_RW_PIN_ID,LOGIC_LOW); /* write data to LCD so RW=0 */
-	delay_ms(1); /* delay for processing Tas = 50ns */
+	delay_ns(50); /* delay for processing Tas = 50ns */
 	GPIO_writePin(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_HIGH); /* Enable LCD E=1 */
-	delay_ms(1); /* delay for processing Tpw - Tdws = 190ns */
+	delay_ns(190); /* delay for processing Tpw - Tdws = 190ns */
 
 #if (LCD_DATA_BITS_MODE == 4)
 	/* out the last 4 bits of the required command to the data bus D4 --> D7 */
@@ -76,11 +80,11 @@ void LCD_sendCommand(uint8 command)
 #endif
 	GPIO_writePort(LCD_DATA_PORT_ID,lcd_port_value);
 
-	delay_ms(1); /* delay for processing Tdsw = 100ns */
+	delay_ns(100); /* delay for processing Tdsw = 100ns */
 	GPIO_writePin(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_LOW); /* Disable LCD E=0 */
-	delay_ms(1); /* delay for processing Th = 13ns */
+	delay_ns(13); /* delay for processing Th = 13ns */
 	GPIO_writePin(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_HIGH); /* Enable LCD E=1 */
-	delay_ms(1); /* delay for processing Tpw - Tdws = 190ns */
+	delay_ns(190); /* delay for processing Tpw - Tdws = 190ns */
 
 	/* out the first 4 bits of the required command to the data bus D4 --> D7 */
 	lcd_port_value = GPIO_readPort(LCD_DATA_PORT_ID);
@@ -91,16 +95,26 @@ void LCD_sendCommand(uint8 command)
 #endif
 	GPIO_writePort(LCD_DATA_PORT_ID,lcd_port_value);
 
-	delay_ms(1); /* delay for processing Tdsw = 100ns */
+	delay_ns(100); /* delay for processing Tdsw = 100ns */
 	GPIO_writePin(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_LOW); /* Disable LCD E=0 */
-	delay_ms(1); /* delay for processing Th = 13ns */
+	delay_ns(13); /* delay for processing Th = 13ns */
 
 #elif (LCD_DATA_BITS_MODE == 8)
 	GPIO_writePort(LCD_DATA_PORT_ID,command); /* out the required command to the data bus D0 --> D7 */
-	delay_ms(1); /* delay for processing Tdsw = 100ns */
+	delay_ns(100); /* delay for processing Tdsw = 100ns */
 	GPIO_writePin(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_LOW); /* Disable LCD E=0 */
-	delay_ms(1); /* delay for processing Th = 13ns */
+	delay_ns(13); /* delay for processing Th = 13ns */
 #endif
+
+	/* wait until the command is executed */
+	if((command == LCD_CLEAR_COMMAND) || (command == LCD_GO_TO_HOME))
+	{
+		delay_us(LCD_CLEAR_TIME_US);
+	}
+	else
+	{
+		delay_us(LCD_EXECUTION_TIME_US);
+	}
 }
 
 /*
@@ -112,9 +126,9 @@ void LCD_displayCharacter(uint8 data)
 	uint8 lcd_port_value = 0;
 	GPIO_writePin(LCD_RS_PORT_ID,LCD_RS_PIN_ID,LOGIC_HIGH); /* Data Mode RS=1 */
 	GPIO_writePin(LCD_RW_PORT_ID,LCD_RW_PIN_ID,LOGIC_LOW); /* write data to LCD so RW=0 */
-	delay_ms(1); /* delay for processing Tas = 50ns */
+	delay_ns(50); /* delay for processing Tas = 50ns */
 	GPIO_writePin(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_HIGH); /* Enable LCD E=1 */
-	delay_ms(1); /* delay for processing Tpw - Tdws = 190ns */
+	delay_ns(190); /* delay for processing Tpw - Tdws = 190ns */
 
 #if (LCD_DATA_BITS_MODE == 4)
 	/* out the last 4 bits of the required data to the data bus D4 --> D7 */
@@ -126,11 +140,11 @@ void LCD_displayCharacter(uint8 data)
 #endif
 	GPIO_writePort(LCD_DATA_PORT_ID,lcd_port_value);
 
-	delay_ms(1); /* delay for processing Tdsw = 100ns */
+	delay_ns(100); /* delay for processing Tdsw = 100ns */
 	GPIO_writePin(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_LOW); /* Disable LCD E=0 */
-	delay_ms(1); /* delay for processing Th = 13ns */
+	delay_ns(13); /* delay for processing Th = 13ns */
 	GPIO_writePin(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_HIGH); /* Enable LCD E=1 */
-	delay_ms(1); /* delay for processing Tpw - Tdws = 190ns */
+	delay_ns(190); /* delay for processing Tpw - Tdws = 190ns */
 
 	/* out the first 4 bits of the required data to the data bus D4 --> D7 */
 	lcd_port_value = GPIO_readPort(LCD_DATA_PORT_ID);
@@ -141,16 +155,18 @@ void LCD_displayCharacter(uint8 data)
 #endif
 	GPIO_writePort(LCD_DATA_PORT_ID,lcd_port_value);
 
-	delay_ms(1); /* delay for processing Tdsw = 100ns */
+	delay_ns(100); /* delay for processing Tdsw = 100ns */
 	GPIO_writePin(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_LOW); /* Disable LCD E=0 */
-	delay_ms(1); /* delay for processing Th = 13ns */
+	delay_ns(13); /* delay for processing Th = 13ns */
 
 #elif (LCD_DATA_BITS_MODE == 8)
 	GPIO_writePort(LCD_DATA_PORT_ID,data); /* out the required data to the data bus D0 --> D7 */
-	delay_ms(1); /* delay for processing Tdsw = 100ns */
+	delay_ns(100); /* delay for processing Tdsw = 100ns */
 	GPIO_writePin(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_LOW); /* Disable LCD E=0 */
-	delay_ms(1); /* delay for processing Th = 13ns */
+	delay_ns(13); /* delay for processing Th = 13ns */
 #endif
+
+	delay_us(LCD_EXECUTION_TIME_US); /* wait until the data is written */
 }
 
 /*
@@ -54,6 +54,16 @@
 
 #define LCD_DATA_PORT_ID               PORTA_ID
 
+/*
+ * Execution times of the commands, the busy flag is not read so the driver waits for them.
+ * The datasheet times are 1.52 ms and 37 us (+4 us for a data write) at 270 kHz, with margin for a slower LCD oscillator.
+ */
+#define LCD_CLEAR_TIME_US              2000
+#define LCD_EXECUTION_TIME_US          50
+
+/* Time for the LCD controller to end its internal reset after the supply rises above 4.5 V, at least 40 ms. */
+#define LCD_POWER_ON_TIME_MS           50
+
 /* LCD Commands */
 #define LCD_CLEAR_COMMAND              0x01
 #define LCD_GO_TO_HOME                 0x02
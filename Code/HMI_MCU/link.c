@@ -0,0 +1,438 @@
+ /******************************************************************************
+ *
+ * Module: LINK
+ *
+ * File Name: link.c
+ *
+ * Description: Source file for the framed link protocol between the two MCUs.
+ *
+ * Author: Mohamed Khaled.
+ *
+ *******************************************************************************/
+
+#include "link.h"
+#include <avr/io.h> /* For SREG */
+#include <avr/interrupt.h> /* For cli() */
+
+/*******************************************************************************
+ *                               User Defined Types                            *
+ *******************************************************************************/
+/*
+ * Description:
+ * States of the frame receiver, one state for each field of the frame.
+ */
+typedef enum
+{
+	WAIT_START, WAIT_LENGTH, WAIT_ADDRESS, WAIT_COMMAND, WAIT_SEQUENCE, WAIT_PAYLOAD, WAIT_CRC_HIGH, WAIT_CRC_LOW
+} LINK_ReceiverState;
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+
+/*
+ * Frames pool given by the application, used as a ring of frames:
+ * the receiver fills g_pool[g_poolHead] and the application reads g_pool[g_poolTail].
+ * The head is only moved by the receiver and the tail only by the application.
+ */
+static LINK_FrameType *g_pool = NULL_PTR;
+static uint8 g_poolSize = 0;
+static volatile uint8 g_poolHead = 0;
+static volatile uint8 g_poolTail = 0;
+
+/* Receiver state, changed by the UART RX ISR in interrupt mode. */
+static volatile LINK_ReceiverState g_rxState = WAIT_START;
+static volatile uint8 g_rxIndex = 0;
+static volatile uint16 g_rxCrc = 0;
+static volatile uint16 g_errorCount = 0;
+
+/* Time in ms and the silence time of the other side, changed by LINK_timerTick. */
+static volatile uint16 g_time = 0;
+static volatile uint16 g_idleTime = LINK_PEER_TIMEOUT_MS;
+/* Set by the receiver for each valid frame and cleared by LINK_timerTick. */
+static volatile boolean g_frameReceived = FALSE;
+
+/* Called by the receiver when a frame is ready. */
+static void (*volatile g_frameCallBackPtr)(void) = NULL_PTR;
+
+/* Address of this MCU on the link. */
+static uint8 g_address = LINK_MASTER_ADDRESS;
+
+/*******************************************************************************
+ *                      Functions Prototypes(Private)                          *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Update the CRC-16 (CCITT) value with one byte.
+ */
+static uint16 LINK_updateCrc(uint16 crc, uint8 data);
+
+/*
+ * Description :
+ * Send one byte through UART and update the CRC with it.
+ */
+static void LINK_sendCrcByte(uint8 data, uint16 *crc);
+
+/*
+ * Description :
+ * Frame receiver, assembles the frame byte by byte in the pool and publishes it
+ * when its CRC is valid. It is called by the UART RX ISR in interrupt mode.
+ */
+static void LINK_receiveByte(uint8 data);
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Update the CRC-16 (CCITT) value with one byte.
+ * Same result as shifting the 8 bits through the polynomial 0x1021, but without a loop
+ * as it is executed in the RX ISR for each received byte.
+ */
+static uint16 LINK_updateCrc(uint16 crc, uint8 data)
+{
+	uint8 x = (uint8)(crc >> 8) ^ data;
+
+	x ^= x >> 4;
+	return (crc << 8) ^ ((uint16)x << 12) ^ ((uint16)x << 5) ^ x;
+}
+
+/*
+ * Description :
+ * Send one byte through UART and update the CRC with it.
+ */
+static void LINK_sendCrcByte(uint8 data, uint16 *crc)
+{
+	UART_sendByte(data);
+	*crc = LINK_updateCrc(*crc, data);
+}
+
+/*
+ * Description :
+ * Reset the frame receiver and the error counter and set the address of this MCU.
+ * The master (LINK_MASTER_ADDRESS) sends the destination address before each frame,
+ * a node enables the UART address filtering and drops frames addressed to other nodes.
+ * The UART should be initialized before using the link and LINK_setFramePool should be
+ * called before receiving.
+ */
+void LINK_init(uint8 address)
+{
+	g_rxState = WAIT_START;
+	g_errorCount = 0;
+	g_address = address;
+	UART_setNodeAddress(address);
+}
+
+/*
+ * Description :
+ * Give the link the buffers that receive the frames, count is LINK_MIN_POOL_SIZE to LINK_MAX_POOL_SIZE.
+ * The frames are assembled by the UART RX ISR directly in the pool, one buffer is always
+ * reserved for the frame under reception, so up to count - 1 frames wait for the application.
+ * A smaller pool is rejected and the receiver is left stopped.
+ */
+void LINK_setFramePool(LINK_FrameType *pool, uint8 count)
+{
+	/* Stop the receiver while the pool is changed. */
+	UART_setRxCallBack(NULL_PTR);
+	if(count < LINK_MIN_POOL_SIZE)
+	{
+		return;
+	}
+	g_pool = pool;
+	g_poolSize = (count > LINK_MAX_POOL_SIZE) ? LINK_MAX_POOL_SIZE : count;
+	g_poolHead = 0;
+	g_poolTail = 0;
+	g_rxState = WAIT_START;
+	UART_setRxCallBack(LINK_receiveByte);
+}
+
+/*
+ * Description :
+ * Set the function called by the UART RX ISR each time a frame is ready in the pool,
+ * the frame itself is read by LINK_getFrame.
+ */
+void LINK_setFrameCallBack(void(*a_ptr)(void))
+{
+	g_frameCallBackPtr = a_ptr;
+}
+
+/*
+ * Description :
+ * Build the frame header and CRC and send the whole frame through UART.
+ */
+void LINK_sendFrame(const LINK_FrameType *frame)
+{
+	uint16 crc = 0xFFFF;
+	uint8 i;
+
+	if(g_address == LINK_MASTER_ADDRESS)
+	{
+		/* Wake up the destination node only. */
+		UART_sendAddress(frame->address);
+	}
+	UART_sendByte(LINK_START_OF_FRAME);
+	LINK_sendCrcByte(frame->length, &crc);
+	LINK_sendCrcByte(frame->address, &crc);
+	LINK_sendCrcByte(frame->command, &crc);
+	LINK_sendCrcByte(frame->sequence, &crc);
+	for(i = 0; i < frame->length; i++)
+	{
+		LINK_sendCrcByte(frame->payload[i], &crc);
+	}
+	UART_sendByte((uint8)(crc >> 8));
+	UART_sendByte((uint8)crc);
+}
+
+/*
+ * Description :
+ * Frame receiver, assembles the frame byte by byte in the pool and publishes it
+ * when its CRC is valid. It is called by the UART RX ISR in interrupt mode.
+ */
+static void LINK_receiveByte(uint8 data)
+{
+	LINK_FrameType *rxFrame;
+	uint8 nextHead;
+
+	if(g_pool == NULL_PTR)
+	{
+		return;
+	}
+	/* The head buffer is never read by the application, so it is always free for reception. */
+	rxFrame = &g_pool[g_poolHead];
+
+	switch(g_rxState)
+	{
+	case WAIT_START:
+		if(data == LINK_START_OF_FRAME)
+		{
+			g_rxCrc = 0xFFFF;
+			g_rxState = WAIT_LENGTH;
+		}
+		break;
+	case WAIT_LENGTH:
+		if(data > LINK_MAX_PAYLOAD_LENGTH)
+		{
+			/* Can't be a valid frame, search for the next start of frame. */
+			g_errorCount++;
+			g_rxState = WAIT_START;
+			break;
+		}
+		rxFrame->length = data;
+		g_rxCrc = LINK_updateCrc(g_rxCrc, data);
+		g_rxState = WAIT_ADDRESS;
+		break;
+	case WAIT_ADDRESS:
+		rxFrame->address = data;
+		g_rxCrc = LINK_updateCrc(g_rxCrc, data);
+		g_rxState = WAIT_COMMAND;
+		break;
+	case WAIT_COMMAND:
+		rxFrame->command = data;
+		g_rxCrc = LINK_updateCrc(g_rxCrc, data);
+		g_rxState = WAIT_SEQUENCE;
+		break;
+	case WAIT_SEQUENCE:
+		rxFrame->sequence = data;
+		g_rxCrc = LINK_updateCrc(g_rxCrc, data);
+		g_rxIndex = 0;
+		g_rxState = (rxFrame->length == 0) ? WAIT_CRC_HIGH : WAIT_PAYLOAD;
+		break;
+	case WAIT_PAYLOAD:
+		rxFrame->payload[g_rxIndex++] = data;
+		g_rxCrc = LINK_updateCrc(g_rxCrc, data);
+		if(g_rxIndex == rxFrame->length)
+		{
+			g_rxState = WAIT_CRC_HIGH;
+		}
+		break;
+	case WAIT_CRC_HIGH:
+		g_rxCrc ^= (uint16)data << 8;
+		g_rxState = WAIT_CRC_LOW;
+		break;
+	case WAIT_CRC_LOW:
+		g_rxCrc ^= data;
+		g_rxState = WAIT_START;
+		if(g_rxCrc != 0)
+		{
+			g_errorCount++;
+			break;
+		}
+		/* A node only takes the frames addressed to it or broadcast. */
+		if((g_address != LINK_MASTER_ADDRESS) && (rxFrame->address != g_address) &&
+				(rxFrame->address != LINK_BROADCAST_ADDRESS))
+		{
+			break;
+		}
+		nextHead = g_poolHead + 1;
+		if(nextHead == g_poolSize)
+		{
+			nextHead = 0;
+		}
+		if(nextHead == g_poolTail)
+		{
+			/* All the other buffers wait for the application, drop the frame. */
+			g_errorCount++;
+			break;
+		}
+		g_poolHead = nextHead;
+		g_frameReceived = TRUE;
+		if(g_frameCallBackPtr != NULL_PTR)
+		{
+			(*g_frameCallBackPtr)();
+		}
+		break;
+	}
+}
+
+/*
+ * Description :
+ * Returns the oldest received frame in the pool without copying it, or NULL_PTR if there
+ * is no frame. The frame stays valid till it is given back by LINK_releaseFrame.
+ */
+LINK_FrameType* LINK_getFrame(void)
+{
+	uint8 data;
+
+	/* In polling mode, or before the pool is set, the bytes are still in the UART. */
+	while((g_poolHead == g_poolTail) && UART_tryReceive(&data))
+	{
+		LINK_receiveByte(data);
+	}
+	if(g_poolHead == g_poolTail)
+	{
+		return NULL_PTR;
+	}
+	return &g_pool[g_poolTail];
+}
+
+/*
+ * Description :
+ * Give the frame returned by LINK_getFrame back to the pool.
+ */
+void LINK_releaseFrame(void)
+{
+	uint8 nextTail;
+
+	if(g_poolHead == g_poolTail)
+	{
+		return;
+	}
+	nextTail = g_poolTail + 1;
+	if(nextTail == g_poolSize)
+	{
+		nextTail = 0;
+	}
+	g_poolTail = nextTail;
+}
+
+/*
+ * Description :
+ * Non-blocking receive, returns TRUE and copies the oldest received frame if there is one.
+ * Corrupted frames are dropped and counted.
+ */
+boolean LINK_pollFrame(LINK_FrameType *frame)
+{
+	LINK_FrameType *received = LINK_getFrame();
+
+	if(received == NULL_PTR)
+	{
+		return FALSE;
+	}
+	*frame = *received;
+	LINK_releaseFrame();
+	return TRUE;
+}
+
+/*
+ * Description :
+ * Wait until a complete frame with a valid CRC is received.
+ */
+void LINK_receiveFrame(LINK_FrameType *frame)
+{
+	while(!LINK_pollFrame(frame)){}
+}
+
+/*
+ * Description :
+ * Returns the number of dropped frames because of CRC or length errors or a full pool.
+ */
+uint16 LINK_getErrorCount(void)
+{
+	/* The counter is 16 bits and updated by the RX ISR, so read it atomically. */
+	uint8 sreg = SREG;
+	uint16 count;
+
+	cli();
+	count = g_errorCount;
+	SREG = sreg;
+	return count;
+}
+
+/*
+ * Description :
+ * Should be called each 1 ms, usually from a timer callback, to count the time and
+ * follow the silence of the other side.
+ */
+void LINK_timerTick(void)
+{
+	g_time++;
+	if(g_frameReceived)
+	{
+		g_frameReceived = FALSE;
+		g_idleTime = 0;
+	}
+	else if(g_idleTime < LINK_PEER_TIMEOUT_MS)
+	{
+		g_idleTime++;
+	}
+}
+
+/*
+ * Description :
+ * Returns the time in ms counted by LINK_timerTick, it wraps around after 65535 ms.
+ */
+uint16 LINK_getTime(void)
+{
+	/* The counter is 16 bits and updated by the timer ISR, so read it atomically. */
+	uint8 sreg = SREG;
+	uint16 time;
+
+	cli();
+	time = g_time;
+	SREG = sreg;
+	return time;
+}
+
+/*
+ * Description :
+ * Returns LINK_UP if a valid frame is received in the last LINK_PEER_TIMEOUT_MS.
+ */
+LINK_StateType LINK_getState(void)
+{
+	uint8 sreg = SREG;
+	LINK_StateType state;
+
+	cli();
+	/* A frame not yet seen by LINK_timerTick counts as received now. */
+	state = (g_frameReceived || (g_idleTime < LINK_PEER_TIMEOUT_MS)) ? LINK_UP : LINK_DOWN;
+	SREG = sreg;
+	return state;
+}
+
+/*
+ * Description :
+ * Drop the partially received frame and the frames waiting in the pool, used after the
+ * link is lost or the baud rate is changed so the receiver starts from a clean state.
+ */
+void LINK_resync(void)
+{
+	uint8 sreg = SREG;
+
+	cli();
+	g_rxState = WAIT_START;
+	/* The tail belongs to the application, so the waiting frames are dropped by moving it. */
+	g_poolTail = g_poolHead;
+	SREG = sreg;
+}
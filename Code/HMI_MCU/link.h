@@ -0,0 +1,185 @@
+ /******************************************************************************
+ *
+ * Module: LINK
+ *
+ * File Name: link.h
+ *
+ * Description: Header file for the framed link protocol between the two MCUs.
+ *
+ * Author: Mohamed Khaled.
+ *
+ *******************************************************************************/
+
+#ifndef LINK_H_
+#define LINK_H_
+
+#include "std_types.h"
+#include "uart.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/*
+ * Frame format on the wire:
+ *
+ *  +-----+--------+---------+---------+----------+-----------------+--------+--------+
+ *  | SOF | LENGTH | ADDRESS | COMMAND | SEQUENCE | PAYLOAD[LENGTH] | CRC_HI | CRC_LO |
+ *  +-----+--------+---------+---------+----------+-----------------+--------+--------+
+ *
+ * LENGTH is the number of payload bytes only.
+ * ADDRESS is the destination node of a request from the master, or the source node of a
+ * frame sent by a node to the master.
+ * The CRC-16 (CCITT, polynomial 0x1021, initial value 0xFFFF) covers LENGTH, ADDRESS, COMMAND,
+ * SEQUENCE and the PAYLOAD.
+ *
+ * On a multi-drop bus (UART in 9-bit mode) the master sends the destination address as a
+ * UART address frame before each frame, so the other nodes filter the frame in hardware (MPCM).
+ */
+#define LINK_START_OF_FRAME               0x7E
+#define LINK_MAX_PAYLOAD_LENGTH           16
+
+/* Number of bytes in a frame other than the payload. */
+#define LINK_FRAME_OVERHEAD               7
+
+/*
+ * Minimum and maximum number of frames in the pool given by LINK_setFramePool,
+ * one frame of the pool is always kept for the frame under reception.
+ */
+#define LINK_MIN_POOL_SIZE                2
+#define LINK_MAX_POOL_SIZE                8
+
+/*
+ * Time in ms without any valid frame from the other side before it is considered lost.
+ * The master should send a frame (heartbeat) more often than this time.
+ */
+#ifndef LINK_PEER_TIMEOUT_MS
+#define LINK_PEER_TIMEOUT_MS              3000
+#endif
+
+/* Address of the master (HMI MCU), the nodes are numbered from 1. */
+#define LINK_MASTER_ADDRESS               UART_NO_NODE_ADDRESS
+/* Frames sent to this address are executed by all nodes and never answered. */
+#define LINK_BROADCAST_ADDRESS            UART_BROADCAST_ADDRESS
+
+/*******************************************************************************
+ *                               User Defined Types                            *
+ *******************************************************************************/
+/*
+ * Description:
+ * State of the link, it is down till the first valid frame is received and after
+ * LINK_PEER_TIMEOUT_MS without any valid frame.
+ */
+typedef enum
+{
+	LINK_DOWN, LINK_UP
+} LINK_StateType;
+
+/*
+ * Description:
+ * One frame of the link protocol.
+ */
+typedef struct
+{
+	uint8 address;
+	uint8 command;
+	uint8 sequence;
+	uint8 length;
+	uint8 payload[LINK_MAX_PAYLOAD_LENGTH];
+} LINK_FrameType;
+
+/*******************************************************************************
+ *                      Functions Prototypes                                   *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Reset the frame receiver and the error counter and set the address of this MCU.
+ * The master (LINK_MASTER_ADDRESS) sends the destination address before each frame,
+ * a node enables the UART address filtering and drops frames addressed to other nodes.
+ * The UART should be initialized before using the link and LINK_setFramePool should be
+ * called before receiving.
+ */
+void LINK_init(uint8 address);
+
+/*
+ * Description :
+ * Give the link the buffers that receive the frames, count is LINK_MIN_POOL_SIZE to LINK_MAX_POOL_SIZE.
+ * The frames are assembled by the UART RX ISR directly in the pool, one buffer is always
+ * reserved for the frame under reception, so up to count - 1 frames wait for the application.
+ * A smaller pool is rejected and the receiver is left stopped.
+ */
+void LINK_setFramePool(LINK_FrameType *pool, uint8 count);
+
+/*
+ * Description :
+ * Set the function called by the UART RX ISR each time a frame is ready in the pool,
+ * the frame itself is read by LINK_getFrame.
+ */
+void LINK_setFrameCallBack(void(*a_ptr)(void));
+
+/*
+ * Description :
+ * Returns the oldest received frame in the pool without copying it, or NULL_PTR if there
+ * is no frame. The frame stays valid till it is given back by LINK_releaseFrame.
+ */
+LINK_FrameType* LINK_getFrame(void);
+
+/*
+ * Description :
+ * Give the frame returned by LINK_getFrame back to the pool.
+ */
+void LINK_releaseFrame(void);
+
+/*
+ * Description :
+ * Build the frame header and CRC and send the whole frame through UART.
+ */
+void LINK_sendFrame(const LINK_FrameType *frame);
+
+/*
+ * Description :
+ * Non-blocking receive, returns TRUE and copies the oldest received frame if there is one.
+ * Corrupted frames are dropped and counted.
+ */
+boolean LINK_pollFrame(LINK_FrameType *frame);
+
+/*
+ * Description :
+ * Wait until a complete frame with a valid CRC is received.
+ */
+void LINK_receiveFrame(LINK_FrameType *frame);
+
+/*
+ * Description :
+ * Returns the number of dropped frames because of CRC or length errors or a full pool.
+ */
+uint16 LINK_getErrorCount(void);
+
+/*
+ * Description :
+ * Should be called each 1 ms, usually from a timer callback, to count the time and
+ * follow the silence of the other side.
+ */
+void LINK_timerTick(void);
+
+/*
+ * Description :
+ * Returns the time in ms counted by LINK_timerTick, it wraps around after 65535 ms.
+ */
+uint16 LINK_getTime(void);
+
+/*
+ * Description :
+ * Returns LINK_UP if a valid frame is received in the last LINK_PEER_TIMEOUT_MS.
+ */
+LINK_StateType LINK_getState(void);
+
+/*
+ * Description :
+ * Drop the partially received frame and the frames waiting in the pool, used after the
+ * link is lost or the baud rate is changed so the receiver starts from a clean state.
+ */
+void LINK_resync(void);
+
+#endif /* LINK_H_ */
@@ -0,0 +1,87 @@
+ /******************************************************************************
+ *
+ * Module: POWER
+ *
+ * File Name: power.c
+ *
+ * Description: Source file for the idle mode, the CPU sleeps between the events and the
+ *              system tick is stopped until the next software timer expiry.
+ *
+ * Author: Mohamed Khaled.
+ *
+ *******************************************************************************/
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include "power.h"
+#include "timer.h"
+#include "sw_timer.h"
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+
+/* Time asleep in ms and the us less than 1 ms not counted yet, and the time of POWER_init. */
+static uint32 g_sleepMillis = 0;
+static uint16 g_sleepMicros = 0;
+static uint32 g_startMillis = 0;
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+void POWER_init(void)
+{
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	g_sleepMillis = 0;
+	g_sleepMicros = 0;
+	g_startMillis = TIMER_millis();
+}
+
+void POWER_idle(uint8 maxSleepMs)
+{
+	uint16 idleTime = SWTIMER_getIdleTime();
+	uint32 start;
+	uint32 sleepTime;
+
+	if(idleTime > maxSleepMs)
+	{
+		idleTime = maxSleepMs;
+	}
+	if(idleTime >= POWER_TICKLESS_MIN_MS)
+	{
+		TIMER_stretchSystemTick((uint8)idleTime);
+	}
+
+	start = TIMER_micros();
+	sleep_enable();
+	/* The instruction after sei runs before any interrupt, so a wake up can't come before the sleep. */
+	sei();
+	sleep_cpu();
+	sleep_disable();
+	sleepTime = TIMER_micros() - start;
+
+	/* The ms of the stretched tick are handled before the events they post. */
+	TIMER_resumeSystemTick();
+
+	sleepTime += g_sleepMicros;
+	g_sleepMillis += sleepTime / 1000UL;
+	g_sleepMicros = (uint16)(sleepTime % 1000UL);
+}
+
+uint16 POWER_getSleepRatio(void)
+{
+	uint32 total = TIMER_millis() - g_startMillis;
+
+	if(total == 0)
+	{
+		return 0;
+	}
+	/* The product would overflow after about 71 minutes asleep. */
+	if(g_sleepMillis < (0xFFFFFFFFUL / 1000UL))
+	{
+		return (uint16)((g_sleepMillis * 1000UL) / total);
+	}
+	return (uint16)(g_sleepMillis / (total / 1000UL));
+}
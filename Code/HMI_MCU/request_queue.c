@@ -0,0 +1,553 @@
+ /******************************************************************************
+ *
+ * Module: REQUEST QUEUE
+ *
+ * File Name: request_queue.c
+ *
+ * Description: Source file for the pipelined requests sent by HMI MCU to control MCUs.
+ *
+ * Author: Mohamed Khaled.
+ *
+ *******************************************************************************/
+
+#include "request_queue.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/* The slots of the outstanding requests and of the queued ones. */
+#define REQUEST_SLOT_COUNT                (REQUEST_WINDOW_SIZE + REQUEST_BACKLOG_SIZE)
+
+/*******************************************************************************
+ *                               User Defined Types                            *
+ *******************************************************************************/
+/*
+ * Description:
+ * State of one request slot in the window.
+ */
+typedef enum
+{
+	SLOT_FREE, SLOT_QUEUED, SLOT_WAITING, SLOT_COMPLETE
+} REQUEST_SlotState;
+
+/*
+ * Description:
+ * One outstanding request, the frame holds the request till it is answered so it can be
+ * retransmitted, then it holds the response. The response is discarded if nobody waits for it.
+ */
+typedef struct
+{
+	REQUEST_SlotState state;
+	boolean discardResponse;
+	boolean acknowledged;
+	uint8 retries;
+	uint8 address;
+	uint8 command;
+	uint8 sequence;
+	uint16 deadline;
+	uint16 retryTime;
+	LINK_FrameType frame;
+} REQUEST_SlotType;
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+
+static REQUEST_SlotType g_slots[REQUEST_SLOT_COUNT];
+
+/* Handles of the requests waiting for a free place in the window, in order of submission. */
+static uint8 g_backlog[REQUEST_BACKLOG_SIZE];
+static uint8 g_backlogHead = 0;
+static uint8 g_backlogCount = 0;
+
+/* Sequence number of the next request. */
+static uint8 g_sequence = 0;
+
+/* Time of the last request sent and the controller that answers the heartbeat. */
+static uint16 g_lastSendTime = 0;
+static uint8 g_heartbeatAddress = LINK_BROADCAST_ADDRESS;
+
+/* Number of retransmitted requests. */
+static uint16 g_retryCount = 0;
+
+/* Unsolicited frames, as door events, in order of reception. */
+static LINK_FrameType g_events[REQUEST_EVENT_QUEUE_SIZE];
+static uint8 g_eventHead = 0;
+static uint8 g_eventCount = 0;
+
+/*******************************************************************************
+ *                      Functions Prototypes(Private)                          *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Send the request frame and reserve a slot for its response if it is not broadcast,
+ * or queue it if the window is full.
+ */
+static uint8 REQUEST_submit(uint8 address, uint8 command, const uint8 *payload, uint8 length, boolean discardResponse);
+
+/*
+ * Description :
+ * Send the request of the slot with a new sequence number and start its deadline.
+ */
+static void REQUEST_transmit(REQUEST_SlotType *slot);
+
+/*
+ * Description :
+ * Send the queued requests in order while the window has a free place.
+ */
+static void REQUEST_sendQueued(void);
+
+/*
+ * Description :
+ * Returns the number of requests sent and not answered yet.
+ */
+static uint8 REQUEST_countWaiting(void);
+
+/*
+ * Description :
+ * Store the received frame in the slot of its request or in the event queue.
+ */
+static void REQUEST_dispatch(const LINK_FrameType *frame);
+
+/*
+ * Description :
+ * Store the response in the slot, or free it if nobody waits for the response.
+ */
+static void REQUEST_complete(REQUEST_SlotType *slot, const LINK_FrameType *response);
+
+/*
+ * Description :
+ * Complete the requests that passed their deadline by PROTOCOL_STATUS_TIMEOUT.
+ */
+static void REQUEST_checkDeadlines(uint16 now);
+
+/*
+ * Description :
+ * Send CONTROL_PING if no request is sent for REQUEST_HEARTBEAT_PERIOD_MS.
+ */
+static void REQUEST_sendHeartbeat(uint16 now);
+
+/*
+ * Description :
+ * Retransmit the requests that are not answered or acknowledged in time.
+ */
+static void REQUEST_checkRetries(uint16 now);
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Free all the request slots and the event queue.
+ */
+void REQUEST_init(void)
+{
+	uint8 i;
+
+	for(i = 0; i < REQUEST_SLOT_COUNT; i++)
+	{
+		g_slots[i].state = SLOT_FREE;
+	}
+	g_backlogHead = 0;
+	g_backlogCount = 0;
+	g_eventHead = 0;
+	g_eventCount = 0;
+	g_lastSendTime = LINK_getTime();
+}
+
+/*
+ * Description :
+ * Send the request frame and reserve a slot for its response if it is not broadcast,
+ * or queue it if the window is full.
+ */
+static uint8 REQUEST_submit(uint8 address, uint8 command, const uint8 *payload, uint8 length, boolean discardResponse)
+{
+	REQUEST_SlotType broadcastSlot;
+	REQUEST_SlotType *slot = &broadcastSlot;
+	uint8 handle = REQUEST_NO_HANDLE;
+	boolean queued;
+	uint8 i;
+
+	/* A request waits behind the queued ones, so the requests are sent in order. */
+	queued = (g_backlogCount != 0) ||
+			((address != LINK_BROADCAST_ADDRESS) && (REQUEST_countWaiting() == REQUEST_WINDOW_SIZE));
+	if(queued && (g_backlogCount == REQUEST_BACKLOG_SIZE))
+	{
+		return REQUEST_NO_HANDLE;
+	}
+	if(queued || (address != LINK_BROADCAST_ADDRESS))
+	{
+		/* The slots are freed by the responses, the timeouts or by the application. */
+		for(i = 0; i < REQUEST_SLOT_COUNT; i++)
+		{
+			if(g_slots[i].state == SLOT_FREE)
+			{
+				handle = i;
+				break;
+			}
+		}
+		if(handle == REQUEST_NO_HANDLE)
+		{
+			return REQUEST_NO_HANDLE;
+		}
+		/* Keep the request in the slot for retransmission, broadcast requests are never repeated. */
+		slot = &g_slots[handle];
+	}
+	slot->discardResponse = discardResponse;
+	slot->address = address;
+	slot->command = command;
+	slot->frame.address = address;
+	slot->frame.command = command;
+	slot->frame.length = length;
+	for(i = 0; i < length; i++)
+	{
+		slot->frame.payload[i] = payload[i];
+	}
+
+	if(queued)
+	{
+		slot->state = SLOT_QUEUED;
+		g_backlog[(g_backlogHead + g_backlogCount) % REQUEST_BACKLOG_SIZE] = handle;
+		g_backlogCount++;
+	}
+	else
+	{
+		REQUEST_transmit(slot);
+	}
+	return (address == LINK_BROADCAST_ADDRESS) ? REQUEST_NO_HANDLE : handle;
+}
+
+/*
+ * Description :
+ * Send the request of the slot with a new sequence number and start its deadline.
+ */
+static void REQUEST_transmit(REQUEST_SlotType *slot)
+{
+	uint16 now = LINK_getTime();
+
+	slot->sequence = g_sequence;
+	slot->frame.sequence = g_sequence++;
+	slot->acknowledged = FALSE;
+	slot->retries = 0;
+	slot->deadline = now + REQUEST_TIMEOUT_MS;
+	slot->retryTime = now + REQUEST_RETRY_TIMEOUT_MS;
+	/* Broadcast requests are not answered, so their slot is free once they are sent. */
+	slot->state = (slot->address == LINK_BROADCAST_ADDRESS) ? SLOT_FREE : SLOT_WAITING;
+	g_lastSendTime = now;
+	LINK_sendFrame(&slot->frame);
+}
+
+/*
+ * Description :
+ * Send the queued requests in order while the window has a free place.
+ */
+static void REQUEST_sendQueued(void)
+{
+	uint8 handle;
+
+	while((g_backlogCount != 0) && (REQUEST_countWaiting() < REQUEST_WINDOW_SIZE))
+	{
+		handle = g_backlog[g_backlogHead];
+		g_backlogHead = (g_backlogHead + 1) % REQUEST_BACKLOG_SIZE;
+		g_backlogCount--;
+		REQUEST_transmit(&g_slots[handle]);
+	}
+}
+
+/*
+ * Description :
+ * Returns the number of requests sent and not answered yet.
+ */
+static uint8 REQUEST_countWaiting(void)
+{
+	uint8 count = 0;
+	uint8 i;
+
+	for(i = 0; i < REQUEST_SLOT_COUNT; i++)
+	{
+		if(g_slots[i].state == SLOT_WAITING)
+		{
+			count++;
+		}
+	}
+	return count;
+}
+
+/*
+ * Description :
+ * Send a request with a new sequence number and return its handle to wait for the response.
+ * If the window is full, the request is queued, or dropped if the backlog is full too.
+ */
+uint8 REQUEST_send(uint8 address, uint8 command, const uint8 *payload, uint8 length)
+{
+	return REQUEST_submit(address, command, payload, length, FALSE);
+}
+
+/*
+ * Description :
+ * Send a request whose response is not needed, its slot is freed when the response arrives.
+ */
+void REQUEST_post(uint8 address, uint8 command, const uint8 *payload, uint8 length)
+{
+	REQUEST_submit(address, command, payload, length, TRUE);
+}
+
+/*
+ * Description :
+ * Store the received frame in the slot of its request or in the event queue.
+ */
+static void REQUEST_dispatch(const LINK_FrameType *frame)
+{
+	uint8 i;
+
+	if(frame->command & PROTOCOL_RESPONSE_FLAG)
+	{
+		/* Responses may come out of order, match them by sequence, address and command. */
+		for(i = 0; i < REQUEST_SLOT_COUNT; i++)
+		{
+			if((g_slots[i].state == SLOT_WAITING) && (g_slots[i].sequence == frame->sequence) &&
+					(g_slots[i].address == frame->address) &&
+					((g_slots[i].command | PROTOCOL_RESPONSE_FLAG) == frame->command))
+			{
+				REQUEST_complete(&g_slots[i], frame);
+				return;
+			}
+		}
+		/* Late response of a cancelled request. */
+		return;
+	}
+
+	if((frame->command == CONTROL_ACK) && (frame->length == 1))
+	{
+		/* The request is queued by the controller, stop retransmitting and wait for the response. */
+		for(i = 0; i < REQUEST_SLOT_COUNT; i++)
+		{
+			if((g_slots[i].state == SLOT_WAITING) && (g_slots[i].sequence == frame->sequence) &&
+					(g_slots[i].address == frame->address) && (g_slots[i].command == frame->payload[0]))
+			{
+				g_slots[i].acknowledged = TRUE;
+			}
+		}
+		return;
+	}
+
+	if(frame->command == CONTROL_NACK)
+	{
+		/* The controller dropped a corrupted frame, it may be any of its pending requests. */
+		for(i = 0; i < REQUEST_SLOT_COUNT; i++)
+		{
+			if((g_slots[i].state == SLOT_WAITING) && !g_slots[i].acknowledged &&
+					(g_slots[i].address == frame->address))
+			{
+				g_slots[i].retryTime = LINK_getTime();
+			}
+		}
+		return;
+	}
+
+	/* Unsolicited frame, the oldest one is overwritten if the application is not reading them. */
+	if(g_eventCount == REQUEST_EVENT_QUEUE_SIZE)
+	{
+		g_eventHead = (g_eventHead + 1) % REQUEST_EVENT_QUEUE_SIZE;
+		g_eventCount--;
+	}
+	g_events[(g_eventHead + g_eventCount) % REQUEST_EVENT_QUEUE_SIZE] = *frame;
+	g_eventCount++;
+}
+
+/*
+ * Description :
+ * Consume the received frames, store each response in the slot of its request and keep
+ * the other frames in the event queue.
+ */
+void REQUEST_poll(void)
+{
+	LINK_FrameType *frame;
+	uint16 now;
+
+	/* The frames are read in place from the link pool. */
+	while((frame = LINK_getFrame()) != NULL_PTR)
+	{
+		REQUEST_dispatch(frame);
+		LINK_releaseFrame();
+	}
+	now = LINK_getTime();
+	REQUEST_checkDeadlines(now);
+	REQUEST_sendQueued();
+	REQUEST_checkRetries(now);
+	REQUEST_sendHeartbeat(now);
+}
+
+/*
+ * Description :
+ * Set the controller that receives the heartbeat CONTROL_PING and answers it,
+ * the other controllers only see it broadcast.
+ */
+void REQUEST_setHeartbeatAddress(uint8 address)
+{
+	g_heartbeatAddress = address;
+}
+
+/*
+ * Description :
+ * Store the response in the slot, or free it if nobody waits for the response.
+ */
+static void REQUEST_complete(REQUEST_SlotType *slot, const LINK_FrameType *response)
+{
+	if(slot->discardResponse)
+	{
+		slot->state = SLOT_FREE;
+	}
+	else
+	{
+		slot->frame = *response;
+		slot->state = SLOT_COMPLETE;
+	}
+}
+
+/*
+ * Description :
+ * Complete the requests that passed their deadline by PROTOCOL_STATUS_TIMEOUT.
+ */
+static void REQUEST_checkDeadlines(uint16 now)
+{
+	LINK_FrameType timeout;
+	uint8 i;
+
+	for(i = 0; i < REQUEST_SLOT_COUNT; i++)
+	{
+		/* The time wraps around, so compare the signed difference. */
+		if((g_slots[i].state != SLOT_WAITING) || ((sint16)(now - g_slots[i].deadline) < 0))
+		{
+			continue;
+		}
+		timeout.address = g_slots[i].address;
+		timeout.command = g_slots[i].command | PROTOCOL_RESPONSE_FLAG;
+		timeout.sequence = g_slots[i].sequence;
+		timeout.length = 1;
+		timeout.payload[0] = PROTOCOL_STATUS_TIMEOUT;
+		REQUEST_complete(&g_slots[i], &timeout);
+	}
+}
+
+/*
+ * Description :
+ * Retransmit the requests that are not answered or acknowledged in time.
+ */
+static void REQUEST_checkRetries(uint16 now)
+{
+	uint8 i;
+
+	for(i = 0; i < REQUEST_SLOT_COUNT; i++)
+	{
+		if((g_slots[i].state != SLOT_WAITING) || g_slots[i].acknowledged ||
+				(g_slots[i].retries == REQUEST_MAX_RETRIES) || ((sint16)(now - g_slots[i].retryTime) < 0))
+		{
+			continue;
+		}
+		/* Same sequence, so the controller answers it again without executing it twice. */
+		LINK_sendFrame(&g_slots[i].frame);
+		g_slots[i].retries++;
+		g_slots[i].retryTime = now + ((uint16)REQUEST_RETRY_TIMEOUT_MS << g_slots[i].retries);
+		g_retryCount++;
+	}
+}
+
+/*
+ * Description :
+ * Send CONTROL_PING if no request is sent for REQUEST_HEARTBEAT_PERIOD_MS.
+ */
+static void REQUEST_sendHeartbeat(uint16 now)
+{
+	/* The queued requests are sent as soon as the window has a place, the heartbeat isn't queued behind them. */
+	if(((uint16)(now - g_lastSendTime) < REQUEST_HEARTBEAT_PERIOD_MS) || (g_backlogCount != 0))
+	{
+		return;
+	}
+	/* Keep all the controllers alive, then check the selected one if the window has a free place. */
+	REQUEST_post(LINK_BROADCAST_ADDRESS, CONTROL_PING, NULL_PTR, 0);
+	if((g_heartbeatAddress != LINK_BROADCAST_ADDRESS) && (REQUEST_countWaiting() < REQUEST_WINDOW_SIZE))
+	{
+		REQUEST_post(g_heartbeatAddress, CONTROL_PING, NULL_PTR, 0);
+	}
+}
+
+/*
+ * Description :
+ * Returns TRUE if the response of the request is received.
+ */
+boolean REQUEST_isComplete(uint8 handle)
+{
+	REQUEST_poll();
+	return (handle != REQUEST_NO_HANDLE) && (g_slots[handle].state == SLOT_COMPLETE);
+}
+
+/*
+ * Description :
+ * Wait for the response of the request, copy it to response and free the request slot.
+ */
+void REQUEST_wait(uint8 handle, LINK_FrameType *response)
+{
+	while(!REQUEST_isComplete(handle)){}
+	*response = g_slots[handle].frame;
+	g_slots[handle].state = SLOT_FREE;
+}
+
+/*
+ * Description :
+ * Free the request slot without waiting, a late response is then dropped.
+ */
+void REQUEST_cancel(uint8 handle)
+{
+	uint8 count = g_backlogCount;
+	uint8 i;
+
+	if(handle == REQUEST_NO_HANDLE)
+	{
+		return;
+	}
+	if(g_slots[handle].state == SLOT_QUEUED)
+	{
+		/* Remove it from the backlog and keep the order of the others. */
+		g_backlogCount = 0;
+		for(i = 0; i < count; i++)
+		{
+			if(g_backlog[(g_backlogHead + i) % REQUEST_BACKLOG_SIZE] != handle)
+			{
+				g_backlog[(g_backlogHead + g_backlogCount) % REQUEST_BACKLOG_SIZE] =
+						g_backlog[(g_backlogHead + i) % REQUEST_BACKLOG_SIZE];
+				g_backlogCount++;
+			}
+		}
+	}
+	g_slots[handle].state = SLOT_FREE;
+}
+
+/*
+ * Description :
+ * Returns TRUE and copies the oldest unsolicited frame if there is one.
+ */
+boolean REQUEST_getEvent(LINK_FrameType *event)
+{
+	REQUEST_poll();
+	if(g_eventCount == 0)
+	{
+		return FALSE;
+	}
+	*event = g_events[g_eventHead];
+	g_eventHead = (g_eventHead + 1) % REQUEST_EVENT_QUEUE_SIZE;
+	g_eventCount--;
+	return TRUE;
+}
+
+/*
+ * Description :
+ * Returns the number of retransmitted requests, with LINK_getErrorCount it measures the link quality.
+ */
+uint16 REQUEST_getRetryCount(void)
+{
+	return g_retryCount;
+}
@@ -0,0 +1,149 @@
+ /******************************************************************************
+ *
+ * Module: REQUEST QUEUE
+ *
+ * File Name: request_queue.h
+ *
+ * Description: Header file for the pipelined requests sent by HMI MCU to control MCUs.
+ *
+ * Author: Mohamed Khaled.
+ *
+ *******************************************************************************/
+
+#ifndef REQUEST_QUEUE_H_
+#define REQUEST_QUEUE_H_
+
+#include "std_types.h"
+#include "link.h"
+#include "door_protocol.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/* Maximum number of requests waiting for their responses at the same time. */
+#define REQUEST_WINDOW_SIZE               PROTOCOL_MAX_OUTSTANDING_REQUESTS
+
+/* Number of unsolicited frames (events) kept till the application reads them. */
+#define REQUEST_EVENT_QUEUE_SIZE          2
+
+/*
+ * Number of requests kept in order while the window is full, they are sent by REQUEST_poll
+ * as the outstanding requests are answered, so sending a request never blocks.
+ */
+#ifndef REQUEST_BACKLOG_SIZE
+#define REQUEST_BACKLOG_SIZE              2
+#endif
+
+/* Returned instead of a handle for the requests that have no response (broadcast) or are dropped. */
+#define REQUEST_NO_HANDLE                 0xFF
+
+/*
+ * Time in ms to wait for a response, then the request is completed by PROTOCOL_STATUS_TIMEOUT.
+ * It should cover the slowest request, saving a password takes about 70 ms.
+ */
+#ifndef REQUEST_TIMEOUT_MS
+#define REQUEST_TIMEOUT_MS                PROTOCOL_RETRY_WINDOW_MS
+#endif
+
+/*
+ * A request that is not answered or acknowledged is retransmitted with the same sequence after
+ * REQUEST_RETRY_TIMEOUT_MS, and the time is doubled after each retransmission (exponential backoff).
+ */
+#ifndef REQUEST_RETRY_TIMEOUT_MS
+#define REQUEST_RETRY_TIMEOUT_MS          50
+#endif
+#ifndef REQUEST_MAX_RETRIES
+#define REQUEST_MAX_RETRIES               3
+#endif
+
+#if (REQUEST_TIMEOUT_MS > PROTOCOL_RETRY_WINDOW_MS)
+#error "REQUEST_TIMEOUT_MS must not exceed PROTOCOL_RETRY_WINDOW_MS"
+#endif
+
+#if ((REQUEST_RETRY_TIMEOUT_MS * ((1 << REQUEST_MAX_RETRIES) - 1)) >= REQUEST_TIMEOUT_MS)
+#error "The last retransmission must be sent before REQUEST_TIMEOUT_MS"
+#endif
+
+/* A CONTROL_PING is sent if no request is sent for this time, so the controllers see the master alive. */
+#ifndef REQUEST_HEARTBEAT_PERIOD_MS
+#define REQUEST_HEARTBEAT_PERIOD_MS       250
+#endif
+
+#if (REQUEST_HEARTBEAT_PERIOD_MS >= LINK_PEER_TIMEOUT_MS)
+#error "REQUEST_HEARTBEAT_PERIOD_MS must be less than LINK_PEER_TIMEOUT_MS"
+#endif
+
+/*******************************************************************************
+ *                      Functions Prototypes                                   *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Free all the request slots and the event queue.
+ */
+void REQUEST_init(void);
+
+/*
+ * Description :
+ * Send a request with a new sequence number and return its handle to wait for the response.
+ * If the window is full, the request is sent by REQUEST_poll after one of the outstanding requests
+ * is answered. Returns REQUEST_NO_HANDLE if the backlog is full too and the request is dropped.
+ */
+uint8 REQUEST_send(uint8 address, uint8 command, const uint8 *payload, uint8 length);
+
+/*
+ * Description :
+ * Send a request whose response is not needed, its slot is freed when the response arrives.
+ * It is queued or dropped as REQUEST_send if the window is full.
+ */
+void REQUEST_post(uint8 address, uint8 command, const uint8 *payload, uint8 length);
+
+/*
+ * Description :
+ * Consume the received frames, store each response in the slot of its request and keep
+ * the other frames in the event queue. It also completes the requests that passed their
+ * deadline, sends the queued requests to the freed slots and sends the heartbeat when the link is idle.
+ * The link time should be counted by LINK_timerTick.
+ */
+void REQUEST_poll(void);
+
+/*
+ * Description :
+ * Set the controller that receives the heartbeat CONTROL_PING and answers it,
+ * the other controllers only see it broadcast.
+ */
+void REQUEST_setHeartbeatAddress(uint8 address);
+
+/*
+ * Description :
+ * Returns TRUE if the response of the request is received.
+ */
+boolean REQUEST_isComplete(uint8 handle);
+
+/*
+ * Description :
+ * Wait for the response of the request, copy it to response and free the request slot.
+ * The response payload is [PROTOCOL_STATUS_TIMEOUT] if it is not received before the deadline.
+ */
+void REQUEST_wait(uint8 handle, LINK_FrameType *response);
+
+/*
+ * Description :
+ * Free the request slot without waiting, a late response is then dropped.
+ */
+void REQUEST_cancel(uint8 handle);
+
+/*
+ * Description :
+ * Returns TRUE and copies the oldest unsolicited frame if there is one.
+ */
+boolean REQUEST_getEvent(LINK_FrameType *event);
+
+/*
+ * Description :
+ * Returns the number of retransmitted requests, with LINK_getErrorCount it measures the link quality.
+ */
+uint16 REQUEST_getRetryCount(void);
+
+#endif /* REQUEST_QUEUE_H_ */
@@ -0,0 +1,320 @@
+ /******************************************************************************
+ *
+ * Module: SOFTWARE TIMER
+ *
+ * File Name: sw_timer.c
+ *
+ * Description: Source file for the software timers, one-shot and periodic timers in a
+ *              hierarchical timer wheel driven by the 1 ms system tick of timer 1.
+ *
+ * Author: Mohamed Khaled.
+ *
+ *******************************************************************************/
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "sw_timer.h"
+#include "timer.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+#define SWTIMER_SLOTS_PER_LEVEL           (1 << SWTIMER_LEVEL_BITS)
+#define SWTIMER_SLOT_MASK                 (SWTIMER_SLOTS_PER_LEVEL - 1)
+#define SWTIMER_SLOTS                     (SWTIMER_LEVELS * SWTIMER_SLOTS_PER_LEVEL)
+
+/* End of a slot list. */
+#define SWTIMER_NONE                      0xFF
+/* Values of the slot of a timer that is not in a list. */
+#define SWTIMER_STOPPED                   0xFE
+#define SWTIMER_FREE                      0xFF
+
+/*******************************************************************************
+ *                               Types Declaration                             *
+ *******************************************************************************/
+
+typedef struct
+{
+	void (*callBack)(void);
+	uint16 expiry;					/* Wheel time of the next expiry. */
+	uint16 period;					/* 0 for a one-shot timer. */
+	uint8 next;						/* Doubly linked list of the slot, for O(1) stop. */
+	uint8 previous;
+	uint8 slot;						/* Slot of the list, SWTIMER_STOPPED or SWTIMER_FREE. */
+} SWTIMER_TimerType;
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+
+static SWTIMER_TimerType g_timers[SWTIMER_MAX_TIMERS];
+/* First timer of each slot list, level by level. */
+static uint8 g_slotHead[SWTIMER_SLOTS];
+/* Wheel time, the number of ticks modulo 65536. */
+static uint16 g_wheelTime = 0;
+/* Called at each tick before the timers. */
+static void (*volatile g_tickCallBack)(void) = NULL_PTR;
+
+/*******************************************************************************
+ *                      Private Functions Prototypes                           *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Adds the timer to the slot of its expiry, the lowest level whose block holds the current time.
+ */
+static void SWTIMER_insert(uint8 index);
+
+/*
+ * Description :
+ * Removes the timer from its slot list.
+ */
+static void SWTIMER_remove(uint8 index);
+
+/*
+ * Description :
+ * Moves the timers of the slot of a higher level to the lower levels.
+ */
+static void SWTIMER_cascade(uint8 slot);
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+void SWTIMER_init(void)
+{
+	uint8 sreg = SREG;
+
+	cli();
+	for(uint8 i = 0; i < SWTIMER_MAX_TIMERS; i++)
+	{
+		g_timers[i].slot = SWTIMER_FREE;
+	}
+	for(uint8 slot = 0; slot < SWTIMER_SLOTS; slot++)
+	{
+		g_slotHead[slot] = SWTIMER_NONE;
+	}
+	g_wheelTime = 0;
+	SREG = sreg;
+
+	TIMER_setCallBack(SWTIMER_tick, TIMER1_ID);
+	TIMER_startSystemTick();
+}
+
+SWTIMER_Handle SWTIMER_create(void (*callBack)(void))
+{
+	SWTIMER_Handle handle = SWTIMER_INVALID_HANDLE;
+	uint8 sreg = SREG;
+
+	cli();
+	for(uint8 i = 0; i < SWTIMER_MAX_TIMERS; i++)
+	{
+		if(g_timers[i].slot == SWTIMER_FREE)
+		{
+			g_timers[i].callBack = callBack;
+			g_timers[i].slot = SWTIMER_STOPPED;
+			handle = i;
+			break;
+		}
+	}
+	SREG = sreg;
+	return handle;
+}
+
+void SWTIMER_start(SWTIMER_Handle handle, uint16 delayMs, uint16 periodMs)
+{
+	uint8 sreg;
+
+	if((handle >= SWTIMER_MAX_TIMERS) || (g_timers[handle].slot == SWTIMER_FREE))
+	{
+		return;
+	}
+	if(delayMs == 0)
+	{
+		delayMs = 1;
+	}
+	else if(delayMs > SWTIMER_MAX_INTERVAL_MS)
+	{
+		delayMs = SWTIMER_MAX_INTERVAL_MS;
+	}
+	if(periodMs > SWTIMER_MAX_INTERVAL_MS)
+	{
+		periodMs = SWTIMER_MAX_INTERVAL_MS;
+	}
+
+	sreg = SREG;
+	cli();
+	if(g_timers[handle].slot != SWTIMER_STOPPED)
+	{
+		SWTIMER_remove(handle);
+	}
+	g_timers[handle].expiry = g_wheelTime + delayMs;
+	g_timers[handle].period = periodMs;
+	SWTIMER_insert(handle);
+	SREG = sreg;
+}
+
+void SWTIMER_stop(SWTIMER_Handle handle)
+{
+	uint8 sreg;
+
+	if(handle >= SWTIMER_MAX_TIMERS)
+	{
+		return;
+	}
+	sreg = SREG;
+	cli();
+	if(g_timers[handle].slot < SWTIMER_SLOTS)
+	{
+		SWTIMER_remove(handle);
+		g_timers[handle].slot = SWTIMER_STOPPED;
+	}
+	SREG = sreg;
+}
+
+boolean SWTIMER_isRunning(SWTIMER_Handle handle)
+{
+	/* The slot is one byte, so it is read atomically. */
+	return (handle < SWTIMER_MAX_TIMERS) && (g_timers[handle].slot < SWTIMER_SLOTS);
+}
+
+void SWTIMER_setTickCallBack(void (*callBack)(void))
+{
+	g_tickCallBack = callBack;
+}
+
+uint16 SWTIMER_getIdleTime(void)
+{
+	uint16 idleTime = SWTIMER_NO_EXPIRY;
+	uint16 timeLeft;
+	uint8 sreg = SREG;
+
+	cli();
+	for(uint8 i = 0; i < SWTIMER_MAX_TIMERS; i++)
+	{
+		if(g_timers[i].slot < SWTIMER_SLOTS)
+		{
+			/* A running timer always expires after the current wheel time. */
+			timeLeft = g_timers[i].expiry - g_wheelTime;
+			if(timeLeft < idleTime)
+			{
+				idleTime = timeLeft;
+			}
+		}
+	}
+	SREG = sreg;
+	return idleTime;
+}
+
+void SWTIMER_tick(void)
+{
+	uint8 slot;
+	uint8 index;
+	uint16 time = ++g_wheelTime;
+
+	if(g_tickCallBack != NULL_PTR)
+	{
+		(*g_tickCallBack)();
+	}
+
+	/* When a block of a level starts, its slot in the next level is moved down, the highest level first. */
+	if((time & SWTIMER_SLOT_MASK) == 0)
+	{
+		if((time & 0x00FF) == 0)
+		{
+			if((time & 0x0FFF) == 0)
+			{
+				SWTIMER_cascade((3 * SWTIMER_SLOTS_PER_LEVEL) + (uint8)(time >> 12));
+			}
+			SWTIMER_cascade((2 * SWTIMER_SLOTS_PER_LEVEL) + (uint8)((time >> 8) & SWTIMER_SLOT_MASK));
+		}
+		SWTIMER_cascade(SWTIMER_SLOTS_PER_LEVEL + (uint8)((time >> 4) & SWTIMER_SLOT_MASK));
+	}
+
+	/* All the timers in the level 0 slot expire now. A callback may start or stop any timer. */
+	slot = (uint8)(time & SWTIMER_SLOT_MASK);
+	while((index = g_slotHead[slot]) != SWTIMER_NONE)
+	{
+		SWTIMER_remove(index);
+		if(g_timers[index].period != 0)
+		{
+			g_timers[index].expiry = time + g_timers[index].period;
+			SWTIMER_insert(index);
+		}
+		else
+		{
+			g_timers[index].slot = SWTIMER_STOPPED;
+		}
+		if(g_timers[index].callBack != NULL_PTR)
+		{
+			(*g_timers[index].callBack)();
+		}
+	}
+}
+
+static void SWTIMER_insert(uint8 index)
+{
+	uint16 expiry = g_timers[index].expiry;
+	uint16 difference = expiry ^ g_wheelTime;
+	uint8 slot;
+
+	if(difference < 0x0010)
+	{
+		slot = (uint8)(expiry & SWTIMER_SLOT_MASK);
+	}
+	else if(difference < 0x0100)
+	{
+		slot = SWTIMER_SLOTS_PER_LEVEL + (uint8)((expiry >> 4) & SWTIMER_SLOT_MASK);
+	}
+	else if(difference < 0x1000)
+	{
+		slot = (2 * SWTIMER_SLOTS_PER_LEVEL) + (uint8)((expiry >> 8) & SWTIMER_SLOT_MASK);
+	}
+	else
+	{
+		slot = (3 * SWTIMER_SLOTS_PER_LEVEL) + (uint8)(expiry >> 12);
+	}
+
+	g_timers[index].slot = slot;
+	g_timers[index].previous = SWTIMER_NONE;
+	g_timers[index].next = g_slotHead[slot];
+	if(g_slotHead[slot] != SWTIMER_NONE)
+	{
+		g_timers[g_slotHead[slot]].previous = index;
+	}
+	g_slotHead[slot] = index;
+}
+
+static void SWTIMER_remove(uint8 index)
+{
+	uint8 next = g_timers[index].next;
+	uint8 previous = g_timers[index].previous;
+
+	if(previous == SWTIMER_NONE)
+	{
+		g_slotHead[g_timers[index].slot] = next;
+	}
+	else
+	{
+		g_timers[previous].next = next;
+	}
+	if(next != SWTIMER_NONE)
+	{
+		g_timers[next].previous = previous;
+	}
+}
+
+static void SWTIMER_cascade(uint8 slot)
+{
+	uint8 index = g_slotHead[slot];
+	uint8 next;
+
+	g_slotHead[slot] = SWTIMER_NONE;
+	while(index != SWTIMER_NONE)
+	{
+		next = g_timers[index].next;
+		SWTIMER_insert(index);
+		index = next;
+	}
+}
@@ -22,6 +22,16 @@
 #include <avr/interrupt.h>
 
 
+/***********************************************************************
+ *                              Definitions                             *
+ ***********************************************************************/
+/*
+ * Counts of timer 1 that may pass between reading TCNT1 and writing OCR1A when the tick length is changed,
+ * a compare match closer than this could be missed.
+ */
+#define TIMER_TICK_MARGIN_COUNTS         64
+
+
 /***********************************************************************
  *                            Global Variables                          *
  ***********************************************************************/
@@ -43,6 +53,31 @@ static volatile void (*g_timer1CallBackPtr)(void) = NULL_PTR;
  * that can be used in any mode of timer2 (overflow or compare)
  */
 static volatile void (*g_timer2CallBackPtr)(void) = NULL_PTR;
+/*
+ * Description:
+ * Time in ms counted by the system tick and its state, timer 1 is kept running when it is TRUE.
+ */
+static volatile uint32 g_systemMillis = 0;
+static boolean g_systemTickStarted = FALSE;
+/*
+ * Description:
+ * Length in ms of the current system tick, more than 1 while it is stretched.
+ * While the CPU sleeps in a stretched tick, the ms that are passed are counted in g_lateTicks
+ * and the callback is called for them by TIMER_resumeSystemTick.
+ */
+static volatile uint8 g_systemTickLength = 1;
+static volatile boolean g_systemTickStretched = FALSE;
+static volatile uint16 g_lateTicks = 0;
+
+
+/***********************************************************************
+ *                      Private Functions Prototypes                    *
+ ***********************************************************************/
+/*
+ * Description:
+ * Counts the ms of the system tick that just ended as late ticks and makes the next tick 1 ms.
+ */
+static void TIMER_countLateTicks( void );
 
 
 /***********************************************************************
@@ -184,7 +219,10 @@ void TIMER_Deinit( TIMER_ID timerID )
 		TCCR0 = 0;
 		break;
 	case TIMER1_ID:
-		TCCR1B = 0;
+		if(!g_systemTickStarted)
+		{
+			TCCR1B = 0;
+		}
 		break;
 	case TIMER2_ID:
 		TCCR2 = 0;
@@ -193,6 +231,183 @@ void TIMER_Deinit( TIMER_ID timerID )
 }
 
 
+/*
+ * Description:
+ * Starts timer 1 as the free running system tick if it is not started yet.
+ */
+void TIMER_startSystemTick( void )
+{
+	if(g_systemTickStarted)
+	{
+		return;
+	}
+	/* T_TIMER1 = 8 / F_CPU, the counter is cleared after TIMER_SYSTEM_TICK_COUNTS counts = 1ms. */
+	TIMER_ConfigType config = {TIMER1_ID, COMPARE_MODE, 0, TIMER_SYSTEM_TICK_COUNTS - 1, F_CPU_8};
+	g_systemTickStarted = TRUE;
+	TIMER_Init(&config);
+}
+
+
+/*
+ * Description:
+ * Returns the time in ms since the system tick is started, it wraps around after about 49 days.
+ */
+uint32 TIMER_millis( void )
+{
+	/* The counter is 32 bits and updated by the tick ISR, so read it atomically. */
+	uint8 sreg = SREG;
+	uint32 millis;
+
+	cli();
+	millis = g_systemMillis;
+	SREG = sreg;
+	return millis;
+}
+
+
+/*
+ * Description:
+ * Returns the time in us since the system tick is started, it wraps around after about 71 minutes.
+ */
+uint32 TIMER_micros( void )
+{
+	uint8 sreg = SREG;
+	uint32 millis;
+	uint16 count;
+
+	cli();
+	millis = g_systemMillis;
+	count = TCNT1;
+	/* The counter is already cleared if the compare match of this tick is not handled yet. */
+	if((TIFR & (1<<OCF1A)) && (count < OCR1A))
+	{
+		millis += g_systemTickLength;
+	}
+	SREG = sreg;
+#if (TIMER_SYSTEM_TICK_COUNTS == 1000UL)
+	/* One count is 1us. */
+	return millis * 1000UL + count;
+#else
+	return millis * 1000UL + ((uint32)count * 1000UL) / TIMER_SYSTEM_TICK_COUNTS;
+#endif
+}
+
+
+/*
+ * Description:
+ * Makes the current system tick end after ms (up to TIMER_MAX_SYSTEM_TICK_MS) instead of 1 ms, so the
+ * CPU can sleep without being woken each 1 ms. It must be called with the interrupts disabled.
+ */
+void TIMER_stretchSystemTick( uint8 ms )
+{
+	uint16 top;
+	uint16 count;
+
+	if(!g_systemTickStarted || g_systemTickStretched || (ms <= g_systemTickLength))
+	{
+		return;
+	}
+	if(ms > TIMER_MAX_SYSTEM_TICK_MS)
+	{
+		ms = TIMER_MAX_SYSTEM_TICK_MS;
+	}
+	top = (uint16)((uint32)ms * TIMER_SYSTEM_TICK_COUNTS - 1UL);
+	/*
+	 * OCR1A isn't buffered in CTC mode, a compare match that is pending or too close would be missed.
+	 * The flag is checked after the counter is read, so a match between them is seen.
+	 */
+	count = TCNT1;
+	if((TIFR & (1<<OCF1A)) || ((uint32)count + TIMER_TICK_MARGIN_COUNTS >= OCR1A))
+	{
+		return;
+	}
+	OCR1A = top;
+	g_systemTickLength = ms;
+	g_systemTickStretched = TRUE;
+}
+
+
+/*
+ * Description:
+ * Ends the stretched system tick after the CPU is woken up and calls the callback for each ms that is
+ * passed with the interrupts disabled, as the ISR does, so the callback doesn't race the other ISRs.
+ * The pending interrupts are served between the ms. It must be called from the main loop before the next stretch.
+ */
+void TIMER_resumeSystemTick( void )
+{
+	uint8 sreg = SREG;
+	uint16 count;
+	uint8 passed;
+
+	if(!g_systemTickStretched)
+	{
+		return;
+	}
+	cli();
+	/* The ISR doesn't call the callback before the late ms are handled, so the ms are handled in order. */
+	TIMSK &= ~(1<<OCIE1A);
+	count = TCNT1;
+	if((g_systemTickLength != 1) && !(TIFR & (1<<OCF1A)))
+	{
+		if((uint32)count + TIMER_TICK_MARGIN_COUNTS >= OCR1A)
+		{
+			/* The tick ends in a few us, it is counted by the loop below. */
+			while(!(TIFR & (1<<OCF1A)));
+		}
+		else
+		{
+			/* Woken by another interrupt, the passed ms are counted and the counter is moved back by them. */
+			passed = (uint8)(count / TIMER_SYSTEM_TICK_COUNTS);
+			TCNT1 -= (uint16)(passed * TIMER_SYSTEM_TICK_COUNTS);
+			count -= (uint16)(passed * TIMER_SYSTEM_TICK_COUNTS);
+			/* If the current ms is about to end, the tick is made 2 ms long so its compare match isn't missed. */
+			g_systemTickLength = ((uint32)count + TIMER_TICK_MARGIN_COUNTS >= TIMER_SYSTEM_TICK_COUNTS - 1) ? 2 : 1;
+			OCR1A = (uint16)(g_systemTickLength * TIMER_SYSTEM_TICK_COUNTS - 1UL);
+			g_systemMillis += passed;
+			g_lateTicks += passed;
+		}
+	}
+	SREG = sreg;
+
+	while(1)
+	{
+		cli();
+		/* A tick that ends while its interrupt is disabled is counted here. */
+		if(TIFR & (1<<OCF1A))
+		{
+			TIFR = (1<<OCF1A);
+			TIMER_countLateTicks();
+		}
+		if(g_lateTicks == 0)
+		{
+			break;
+		}
+		g_lateTicks--;
+		if(g_timer1CallBackPtr != NULL_PTR)
+		{
+			(*g_timer1CallBackPtr)();
+		}
+		SREG = sreg;
+	}
+	g_systemTickStretched = FALSE;
+	TIMSK |= (1<<OCIE1A);
+	SREG = sreg;
+}
+
+
+/*
+ * Description:
+ * Counts the ms of the system tick that just ended as late ticks and makes the next tick 1 ms.
+ */
+static void TIMER_countLateTicks( void )
+{
+	g_systemMillis += g_systemTickLength;
+	g_lateTicks += g_systemTickLength;
+	g_systemTickLength = 1;
+	OCR1A = TIMER_SYSTEM_TICK_COUNTS - 1;
+}
+
+
 /***********************************************************************
  *                              ISRs code                               *
  ***********************************************************************/
@@ -238,11 +453,31 @@ ISR( TIMER1_OVF_vect )
  */
 ISR( TIMER1_COMPA_vect )
 {
-	if(g_timer1CallBackPtr != NULL_PTR)
+	uint8 length = g_systemTickLength;
+
+	if(g_systemTickStretched)
 	{
-		(*g_timer1CallBackPtr)();
+		/* The CPU sleeps, the callback is called for the ms of the tick by TIMER_resumeSystemTick. */
+		TIMER_countLateTicks();
+		return;
 	}
-	TIFR |= (1<<OCF1A);
+	if(length != 1)
+	{
+		OCR1A = TIMER_SYSTEM_TICK_COUNTS - 1;
+		g_systemTickLength = 1;
+	}
+	/* The callback is called for each ms of the tick. */
+	do
+	{
+		if(g_systemTickStarted)
+		{
+			g_systemMillis++;
+		}
+		if(g_timer1CallBackPtr != NULL_PTR)
+		{
+			(*g_timer1CallBackPtr)();
+		}
+	} while(--length != 0);
 }
 /*
  * Description:
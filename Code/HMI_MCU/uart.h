@@ -15,6 +15,64 @@
 
 #include "std_types.h"
 
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+#ifndef F_CPU
+#define F_CPU 8000000UL
+#endif
+
+/* Maximum accepted baud rate error in 0.1% units (2%). */
+#define UART_MAX_BAUD_ERROR              20
+
+/*
+ * Compile-time baud rate calculation, the same as UART_setBaudRate does at run time.
+ * UART_BAUD_RATE_IS_VALID can be used in #if to reject a configured rate whose error
+ * exceeds UART_MAX_BAUD_ERROR at the current F_CPU in both normal and double speed.
+ */
+#define UART_DIVISOR_NORMAL(BAUD)        (((F_CPU) + 8UL * (BAUD)) / (16UL * (BAUD)))
+#define UART_DIVISOR_DOUBLE(BAUD)        (((F_CPU) + 4UL * (BAUD)) / (8UL * (BAUD)))
+#define UART_ABS_DIFFERENCE(A,B)         (((A) > (B)) ? ((A) - (B)) : ((B) - (A)))
+#define UART_BAUD_ERROR(CLOCK,DIVISOR,BAUD) \
+	((((DIVISOR) == 0) || ((DIVISOR) > 4096UL)) ? 1000UL : (UART_ABS_DIFFERENCE((CLOCK) / (DIVISOR), (BAUD)) * 1000UL / (BAUD)))
+#define UART_BAUD_ERROR_NORMAL(BAUD)     UART_BAUD_ERROR((F_CPU) / 16UL, UART_DIVISOR_NORMAL(BAUD), (BAUD))
+#define UART_BAUD_ERROR_DOUBLE(BAUD)     UART_BAUD_ERROR((F_CPU) / 8UL, UART_DIVISOR_DOUBLE(BAUD), (BAUD))
+#define UART_BAUD_RATE_IS_VALID(BAUD) \
+	((UART_BAUD_ERROR_NORMAL(BAUD) <= UART_MAX_BAUD_ERROR) || (UART_BAUD_ERROR_DOUBLE(BAUD) <= UART_MAX_BAUD_ERROR))
+
+/* Multi-processor communication mode addresses. */
+#define UART_NO_NODE_ADDRESS             0x00
+#define UART_BROADCAST_ADDRESS           0xFF
+
+/* Size of the ring buffers used in interrupt mode, each size must be a power of two. */
+#define UART_RX_BUFFER_SIZE              32
+#define UART_TX_BUFFER_SIZE              32
+
+#if ((UART_RX_BUFFER_SIZE & (UART_RX_BUFFER_SIZE - 1)) != 0) || (UART_RX_BUFFER_SIZE > 128)
+#error "UART_RX_BUFFER_SIZE should be a power of two and not greater than 128"
+#endif
+
+#if ((UART_TX_BUFFER_SIZE & (UART_TX_BUFFER_SIZE - 1)) != 0) || (UART_TX_BUFFER_SIZE > 128)
+#error "UART_TX_BUFFER_SIZE should be a power of two and not greater than 128"
+#endif
+
+/*
+ * Error injection for testing the link on a noisy line, never enable it in a release build.
+ * UART_ERROR_INJECTION_RATE received data bytes of each 256 are corrupted on average, 0 disables it.
+ * UART_ERROR_INJECTION_DROP selects dropping the corrupted bytes instead of flipping one bit.
+ */
+#ifndef UART_ERROR_INJECTION_RATE
+#define UART_ERROR_INJECTION_RATE        0
+#endif
+#ifndef UART_ERROR_INJECTION_DROP
+#define UART_ERROR_INJECTION_DROP        FALSE
+#endif
+
+#if (UART_ERROR_INJECTION_RATE > 255)
+#error "UART_ERROR_INJECTION_RATE should be less than 256"
+#endif
+
 /*******************************************************************************
  *                               User Defined Types                            *
  *******************************************************************************/
@@ -42,6 +100,17 @@ typedef enum
 {
 	BITS_5, BITS_6, BITS_7, BITS_8, BITS_9
 } UART_BitLength;
+/*
+ * Description:
+ * Select how the UART moves data:
+ *  - Polling mode: every call busy-waits on the UDRE/RXC flags.
+ *  - Interrupt mode: RX complete and data register empty interrupts move the data
+ *    through the RX/TX ring buffers, the application never waits on the hardware.
+ */
+typedef enum
+{
+	UART_POLLING_MODE, UART_INTERRUPT_MODE
+} UART_Mode;
 /*
  * Description:
  * Configuration structure of UART module to select:
@@ -49,13 +118,15 @@ typedef enum
  *  - Type of parity check
  *  - Bit rate
  *  - Length of data in UART frame.
+ *  - Polling or interrupt mode.
  */
 typedef struct
 {
-	uint16 bitRate;
+	uint32 bitRate;
 	UART_BitLength dataLength; /*5, 6, 7, 8 or 9 bits*/
 	UART_ParityType parity;
 	UART_StopBits stopBits;
+	UART_Mode mode;
 } UART_ConfigType;
 
 /*******************************************************************************
@@ -67,22 +138,109 @@ typedef struct
  * Functional responsible for Initialize the UART device by:
  * 1. Setup the Frame format like number of data bits, parity bit type and number of stop bits.
  * 2. Enable the UART.
- * 3. Setup the UART baud rate.
+ * 3. Setup the UART baud rate, the speed mode (U2X) with the lower error is selected.
  */
 void UART_init( UART_ConfigType* config );
 
+/*
+ * Description :
+ * Returns TRUE if the required baud rate can be generated from F_CPU within UART_MAX_BAUD_ERROR.
+ */
+boolean UART_isBaudRateValid(uint32 bitRate);
+
+/*
+ * Description :
+ * Calculate the UBRR value and the U2X bit of the required baud rate and apply them.
+ * Returns FALSE and keeps the current rate if the error exceeds UART_MAX_BAUD_ERROR.
+ */
+boolean UART_setBaudRate(uint32 bitRate);
+
+/*
+ * Description :
+ * Wait until all the queued bytes are completely shifted out of the UART,
+ * used before changing the baud rate or the frame format.
+ */
+void UART_flush(void);
+
 /*
  * Description :
  * Functional responsible for send byte to another UART device.
+ * In interrupt mode it only waits if the TX ring buffer is full.
  */
 void UART_sendByte(const uint8 data);
 
 /*
  * Description :
  * Functional responsible for receive byte from another UART device.
+ * In interrupt mode it waits until the RX ring buffer has a byte.
  */
 uint8 UART_recieveByte(void);
 
+/*
+ * Description :
+ * Non-blocking receive, returns TRUE and stores the byte in data if one is available,
+ * otherwise returns FALSE immediately.
+ */
+boolean UART_tryReceive(uint8 *data);
+
+/*
+ * Description :
+ * Non-blocking send, queues as many bytes as fit in the TX ring buffer and returns
+ * the number of queued bytes. The bytes that did not fit are counted as TX overflow.
+ * In polling mode all the bytes are sent before returning.
+ */
+uint8 UART_write(const uint8 *data, uint8 length);
+
+/*
+ * Description :
+ * Returns the number of received bytes waiting in the RX ring buffer.
+ */
+uint8 UART_available(void);
+
+/*
+ * Description :
+ * Returns the number of received bytes lost because the RX ring buffer was full
+ * or the hardware reported a data overrun.
+ */
+uint16 UART_getRxOverflowCount(void);
+
+/*
+ * Description :
+ * Returns the number of bytes refused by UART_write because the TX ring buffer was full.
+ */
+uint16 UART_getTxOverflowCount(void);
+
+/*
+ * Description :
+ * Returns the number of received bytes corrupted or dropped by the error injection,
+ * always 0 if UART_ERROR_INJECTION_RATE is 0.
+ */
+uint16 UART_getInjectedErrorCount(void);
+
+/*
+ * Description :
+ * Send an address frame (9th bit = 1) in multi-processor communication mode to select
+ * the node that receives the next data bytes. The UART should be in 9-bit data mode.
+ */
+void UART_sendAddress(const uint8 address);
+
+/*
+ * Description :
+ * Set the address of this node and enable multi-processor communication mode (MPCM).
+ * The hardware then ignores all data frames till an address frame with this address or
+ * UART_BROADCAST_ADDRESS is received. UART_NO_NODE_ADDRESS disables the filtering.
+ * The UART should be in 9-bit data mode.
+ */
+void UART_setNodeAddress(const uint8 address);
+
+/*
+ * Description :
+ * Set the function called by the RX ISR with each received data byte in interrupt mode.
+ * While it is set, the received bytes are passed to it instead of the RX ring buffer,
+ * so a protocol layer can assemble its frames in the ISR. NULL_PTR restores the ring buffer.
+ */
+void UART_setRxCallBack(void(*a_ptr)(uint8 data));
+
 /*
  * Description :
  * Send the required string through UART to the other UART device.
@@ -92,7 +250,8 @@ void UART_sendString(const uint8 *Str);
 /*
  * Description :
  * Receive the required string until the '#' symbol through UART from the other UART device.
+ * At most size - 1 characters are stored, the rest of a longer string is dropped till the '#'.
  */
-void UART_receiveString(uint8 *Str); // Receive until #
+void UART_receiveString(uint8 *Str, uint8 size); // Receive until #
 
 #endif /* UART_H_ */